@@ -0,0 +1,13 @@
+; граничные случаи целой арифметики: переход между машинным словом и cBigNumber.
+; Все вычислители (над AST и машина SECD) дают один и тот же список:
+; ( 9223372036854775808 0 -9223372036854775808 9223372036854775807 -3 -1 18446744073709551616 TRUE FALSE)
+(CONS (DIVE (QUOTE -9223372036854775808) (QUOTE -1))
+(CONS (REM (QUOTE -9223372036854775808) (QUOTE -1))
+(CONS (MUL (QUOTE 9223372036854775808) (QUOTE -1))
+(CONS (SUB (QUOTE 9223372036854775808) (QUOTE 1))
+(CONS (DIVE (QUOTE 7) (QUOTE -2))
+(CONS (REM (QUOTE -7) (QUOTE 2))
+(CONS (MUL (QUOTE 4294967296) (QUOTE 4294967296))
+(CONS (EQUAL (SUB (ADD (QUOTE 9223372036854775807) (QUOTE 1)) (QUOTE 1)) (QUOTE 9223372036854775807))
+(CONS (LE (QUOTE 99999999999999999999) (QUOTE 3))
+    (QUOTE ()))))))))))
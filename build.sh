@@ -18,6 +18,16 @@ echo "⚙️ Compiling project..."
 g++ -std=c++17 -I$SRC_DIR \
     $SRC_DIR/main.cpp \
     $SRC_DIR/Emulator.cpp \
+    $SRC_DIR/Collector.cpp \
+    $SRC_DIR/Resolver.cpp \
+    $SRC_DIR/CekEmulator.cpp \
+    $SRC_DIR/ClosureEmulator.cpp \
+    $SRC_DIR/SecdReader.cpp \
+    $SRC_DIR/SecdVM.cpp \
+    $SRC_DIR/SecdJit.cpp \
+    $SRC_DIR/SecdCompiler.cpp \
+    $SRC_DIR/SecdAot.cpp \
+    $SRC_DIR/MappedFile.cpp \
     $BUILD_DIR/Parser.cpp \
     $BUILD_DIR/Scanner.cpp \
     $SRC_DIR/cBigNumber/Cbignum.cpp \
@@ -31,6 +41,16 @@ g++ -std=c++17 -I$SRC_DIR \
 x86_64-w64-mingw32-g++ -static -I$SRC_DIR \
     $SRC_DIR/main.cpp \
     $SRC_DIR/Emulator.cpp \
+    $SRC_DIR/Collector.cpp \
+    $SRC_DIR/Resolver.cpp \
+    $SRC_DIR/CekEmulator.cpp \
+    $SRC_DIR/ClosureEmulator.cpp \
+    $SRC_DIR/SecdReader.cpp \
+    $SRC_DIR/SecdVM.cpp \
+    $SRC_DIR/SecdJit.cpp \
+    $SRC_DIR/SecdCompiler.cpp \
+    $SRC_DIR/SecdAot.cpp \
+    $SRC_DIR/MappedFile.cpp \
     $BUILD_DIR/Parser.cpp \
     $BUILD_DIR/Scanner.cpp \
     $SRC_DIR/cBigNumber/Cbignum.cpp \
@@ -7,37 +7,208 @@
 
 #include "cBigNumber/Cbignum.h"
 #include "cBigNumber/Cbignums.h"
+#include "Arena.h"
+#include "Environment.h"
+#include "Value.h"
+#include "Symbol.h"
 
 namespace syntax_tree {
 
+// Тег конкретного типа узла, задаётся конструктором при создании узла парсером
+// или эмулятором. Позволяет диспетчеризовать узлы через switch вместо цепочки
+// dynamic_pointer_cast.
+enum class NodeKind : unsigned char {
+    Node, Assign,
+    LiteralInt, LiteralBool, LiteralNil, Identifier,
+    Quote, Car, Cdr, Atom, Literal,
+    Add, Sub, Mul, Dive, Rem, Le, Cons, Equal,
+    Cond,
+    Lambda, FuncClosure, Let, Letrec,
+    List, Pair,
+    // значения SecdVM, которые не переводятся обратно в AST: замыкание и OMEGA
+    Closure, Omega
+};
+
+class ASTNode;
+
+// Дети узла без копирования: указатель на массив и длина (как std::span из C++20).
+class Statements {
+    Ref<ASTNode>* items;
+    size_t count;
+public:
+    typedef std::reverse_iterator<Ref<ASTNode>*> reverse_iterator;
+
+    Statements(Ref<ASTNode>* items, size_t count) : items(items), count(count) {}
+    Statements(std::vector<Ref<ASTNode>>& v) : items(v.data()), count(v.size()) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Ref<ASTNode>& operator[](size_t index) const { return items[index]; }
+    Ref<ASTNode>* begin() const { return items; }
+    Ref<ASTNode>* end() const { return items + count; }
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
+};
+
+// Узел занимает 64 байта: указатель на vtable, счётчик ссылок (см. Ref.h), тег, число
+// детей, арена, из которой выделен узел, и сами дети - до четырёх прямо в узле, больше -
+// в отдельном массиве. Имя типа не хранится, а выводится из тега.
 class ASTNode {
-    std::string node_type;
-    std::vector<std::shared_ptr<ASTNode>> statements;
+    static constexpr uint32_t INLINE = 4;
+    // ёмкость массива в куче - степень двойки, поэтому её можно не хранить
+    static_assert((INLINE & (INLINE - 1)) == 0, "INLINE must be a power of two");
+
+    uint32_t refs = 0;
+    NodeKind kind = NodeKind::Node;
+    uint32_t count = 0;
+    Ref<Arena> arena; // пусто у узлов, созданных makeRef
+    union {
+        Ref<ASTNode> local[INLINE];
+        Ref<ASTNode>* heap;
+        Value cells[2]; // car и cdr пары (PairNode)
+    };
+
+    Ref<ASTNode>* items() { return count > INLINE ? heap : local; }
+    const Ref<ASTNode>* items() const { return count > INLINE ? heap : local; }
+
+    void grow() {
+        uint32_t capacity = 2 * count;
+        auto moved = static_cast<Ref<ASTNode>*>(::operator new(capacity * sizeof(Ref<ASTNode>)));
+        auto old = items();
+        for (uint32_t i = 0; i < count; i++) {
+            new (&moved[i]) Ref<ASTNode>(std::move(old[i]));
+            old[i].~Ref();
+        }
+        if (count > INLINE) {
+            ::operator delete(old);
+        }
+        heap = moved;
+    }
+
+    void clearStatements() {
+        if (count > INLINE) {
+            for (uint32_t i = 0; i < count; i++) {
+                heap[i].~Ref();
+            }
+            ::operator delete(heap);
+            for (auto& item : local) {
+                new (&item) Ref<ASTNode>();
+            }
+        }
+        else {
+            for (auto& item : local) {
+                item.reset();
+            }
+        }
+        count = 0;
+    }
+
+    friend void refRetain(ASTNode* node);
+    friend void refRelease(ASTNode* node);
+    friend unsigned refCount(const ASTNode* node);
+    friend class AST;
+
+protected:
+    // У пары нет детей-узлов: на месте встроенного массива лежат её car и cdr - значения.
+    // openCells делает активным cells, closeCells возвращает пустой массив детей.
+    void openCells(Value car, Value cdr) {
+        for (auto& item : local) {
+            item.~Ref();
+        }
+        new (&cells[0]) Value(std::move(car));
+        new (&cells[1]) Value(std::move(cdr));
+    }
+    void closeCells() {
+        for (auto& cell : cells) {
+            cell.~Value();
+        }
+        for (auto& item : local) {
+            new (&item) Ref<ASTNode>();
+        }
+    }
+    Value& cell(size_t index) { return cells[index]; }
+    const Value& cell(size_t index) const { return cells[index]; }
 
 public:
-    ASTNode() {}
-    ASTNode(std::string t) : node_type(t) {}
-    
-    virtual ~ASTNode() = default;
+    explicit ASTNode(NodeKind k = NodeKind::Node) : kind(k), local{} {}
+    ASTNode(const ASTNode&) = delete;
+    ASTNode& operator=(const ASTNode&) = delete;
+
+    virtual ~ASTNode() {
+        if (count > INLINE) {
+            for (uint32_t i = 0; i < count; i++) {
+                heap[i].~Ref();
+            }
+            ::operator delete(heap);
+        }
+        else {
+            for (auto& item : local) {
+                item.~Ref();
+            }
+        }
+    }
+
+    // имя типа для печати и для ключевых слов из quote
+    const char* getTypeName() const {
+        static const char* const names[] = {
+            "", "ASSIGN",
+            "LiteralInt", "LiteralBool", "NIL", "Identifier",
+            "QUOTE", "CAR", "CDR", "ATOM", "LITERAL",
+            "ADD", "SUB", "MUL", "DIVE", "REM", "LE", "CONS", "EQUAL",
+            "COND",
+            "LAMBDA", "CLOSURE", "LET", "LETREC",
+            "LIST", "LIST",
+            "CLOSURE", "OMEGA"
+        };
+        // заготовка letrec - замыкание без функциональной части
+        if (kind == NodeKind::FuncClosure && count == 0) {
+            return "OMEGA";
+        }
+        return names[static_cast<int>(kind)];
+    }
+    std::string getNodeType() const { return getTypeName(); }
+    NodeKind getKind() const { return kind; }
+    // список: вектор из текста программы или cons-ячейка времени выполнения
+    bool isList() const { return kind == NodeKind::List || kind == NodeKind::Pair; }
+    size_t getStatementCount() const { return count; }
 
-    std::string getNodeType() const { return node_type; }
-    size_t getStatementCount() const { return statements.size(); }
+    Ref<ASTNode>& getStatement(size_t index) {
+        if (index >= count) {
+            throw std::out_of_range("ASTNode: no statement " + std::to_string(index));
+        }
+        return items()[index];
+    }
+    void addStatement(Ref<ASTNode> stmt) {
+        if (count < INLINE) {
+            local[count++] = std::move(stmt);
+            return;
+        }
+        // массив полон, когда число детей - степень двойки
+        if ((count & (count - 1)) == 0) {
+            grow();
+        }
+        new (&heap[count++]) Ref<ASTNode>(std::move(stmt));
+    }
 
-    std::shared_ptr<ASTNode>& getStatement(size_t index) { return statements.at(index); }
-    void addStatement(std::shared_ptr<ASTNode> stmt) { statements.push_back(stmt); }
+    void setStatements(std::vector<Ref<ASTNode>>& new_statements) {
+        clearStatements();
+        addStatements(new_statements);
+    }
+    void setStatements(std::vector<Ref<ASTNode>>&& new_statements) {
+        clearStatements();
+        for (auto& stmt : new_statements) {
+            addStatement(std::move(stmt));
+        }
+    }
+    Statements getStatements() { return Statements(items(), count); }
 
-    void setStatements(std::vector<std::shared_ptr<ASTNode>>& new_statements) { this->statements = new_statements; }
-    std::vector<std::shared_ptr<ASTNode>>& getStatements() { return statements; }
-    
-    void addStatements(std::vector<std::shared_ptr<ASTNode>>& new_statements) {
-        this->statements.insert(
-            std::end(this->statements),
-            std::begin(new_statements),
-            std::end(new_statements)
-        );
+    void addStatements(std::vector<Ref<ASTNode>>& new_statements) {
+        for (const auto& stmt : new_statements) {
+            addStatement(stmt);
+        }
     }
 
-    virtual void printValue(std::ostream& os = std::cout) const { os << node_type; }
+    virtual void printValue(std::ostream& os = std::cout) const { os << getTypeName(); }
 
     void printRec(int deep, int maxDeep, int indent = 0) const {
         std::string indentStr = ""; 
@@ -48,12 +219,12 @@ public:
         std::cout << '\n';
         
         if (deep <= maxDeep)
-        for (const auto& stmt : statements) {
-            stmt->printRec(deep+1, maxDeep, indent + 2);
+        for (uint32_t i = 0; i < count; i++) {
+            items()[i]->printRec(deep+1, maxDeep, indent + 2);
         }
     }
 
-    void print(int indent = 0, std::ostream& os = std::cout) const {
+    virtual void print(int indent = 0, std::ostream& os = std::cout) const {
         std::string indentStr = ""; 
         for (int i = 0; i < indent-1; i++) {indentStr += "    ";} 
         
@@ -61,40 +232,87 @@ public:
         this->printValue(os);
         os << '\n';
         
-        for (const auto& stmt : statements) {
-            stmt->print(indent + 2, os);
+        for (uint32_t i = 0; i < count; i++) {
+            items()[i]->print(indent + 2, os);
         }
     }
 
     virtual void printFlat(int depth = 0, std::ostream& os = std::cout) {
-        if (!statements.empty()) {
+        if (count > 0) {
             os << "(";
         }
         
         printValue(os);
         
-        if (!statements.empty()) {
-            for (const auto& stmt : statements) {
+        if (count > 0) {
+            for (uint32_t i = 0; i < count; i++) {
                 os << " ";
-                stmt->printFlat(depth + 1, os);
+                items()[i]->printFlat(depth + 1, os);
             }
             os << ")";
         }
     }
 };
 
+static_assert(sizeof(void*) != 8 || sizeof(ASTNode) == 64, "ASTNode must fit in a cache line");
+
+inline void refRetain(ASTNode* node) { node->refs++; }
+inline void refRelease(ASTNode* node) {
+    if (--node->refs > 0) {
+        return;
+    }
+    if (node->arena) {
+        // память узла вернётся вместе с ареной; ссылка на неё снимается после деструктора
+        Ref<Arena> arena = std::move(node->arena);
+        node->~ASTNode();
+    }
+    else {
+        delete node;
+    }
+}
+inline unsigned refCount(const ASTNode* node) { return node->refs; }
+
+// Приведение указателя на узел к конкретному типу по тегу NodeKind.
+// Возвращает nullptr, если тег не совпадает (аналог dynamic_pointer_cast без RTTI).
+template <class T>
+Ref<T> node_cast(const Ref<ASTNode>& node) {
+    if (node && node->getKind() == T::Kind) {
+        return refCast<T>(node);
+    }
+    return nullptr;
+}
+
+
+class LiteralInt;
 
 class AST {
 private:
-    std::shared_ptr<ASTNode> root = nullptr;
+    Ref<ASTNode> root = nullptr;
+    // память узлов, созданных через make; общая у копий дерева
+    Ref<Arena> arena;
 
 public:
     AST() {}
-    AST(std::shared_ptr<ASTNode> rootNode) : root(rootNode) {}
+    AST(Ref<ASTNode> rootNode) : root(rootNode) {}
 
-    std::shared_ptr<ASTNode> getRoot() { return root; }
+    Ref<ASTNode> getRoot() { return root; }
+    void setRoot(Ref<ASTNode> rootNode) { root = rootNode; }
     bool isEmpty() const { return root == nullptr; }
 
+    // Узел в арене дерева (парсер, SecdReader): одно выделение на много узлов вместо
+    // отдельного makeRef. Узел может пережить дерево - арена живёт, пока жив он.
+    template <class T, class... Args>
+    Ref<T> make(Args&&... args) {
+        if (!arena) {
+            arena = makeRef<Arena>();
+        }
+        T* node = new (arena->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        node->arena = arena;
+        return Ref<T>(node);
+    }
+    // целое: малые берутся из общего кэша makeInt, остальные создаются в арене
+    Ref<LiteralInt> makeInt(const cBigNumber& v);
+
     void print(bool flat = false, std::ostream& os = std::cout) const {
         if (root) {
             if (!flat) root->print(0);
@@ -108,30 +326,55 @@ public:
 
 
 // unary
-class QuoteNode : public ASTNode { public: QuoteNode(std::string t) : ASTNode(t) {} };
-class CarNode : public ASTNode { public: CarNode(std::string t) : ASTNode(t) {} };
-class CdrNode : public ASTNode { public: CdrNode(std::string t) : ASTNode(t) {} };
-class AtomNode : public ASTNode { public: AtomNode(std::string t) : ASTNode(t) {} };
-class LiteralNode : public ASTNode { public: LiteralNode(std::string t) : ASTNode(t) {} };
+class QuoteNode : public ASTNode {
+    // данные, один раз переведённые вычислителем в значение (списки - в cons-ячейки);
+    // сам текст программы не меняется
+    Value data;
+public:
+    static constexpr NodeKind Kind = NodeKind::Quote;
+    QuoteNode() : ASTNode(Kind) {}
+    const Value& getData() const { return data; }
+    void setData(Value v) { data = std::move(v); }
+};
+class CarNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Car; CarNode() : ASTNode(Kind) {} };
+class CdrNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Cdr; CdrNode() : ASTNode(Kind) {} };
+class AtomNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Atom; AtomNode() : ASTNode(Kind) {} };
+class LiteralNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Literal; LiteralNode() : ASTNode(Kind) {} };
 
 // binary
-class AddNode : public ASTNode { public: AddNode(std::string t) : ASTNode(t) {} };
-class SubNode : public ASTNode { public: SubNode(std::string t) : ASTNode(t) {} };
-class MulNode : public ASTNode { public: MulNode(std::string t) : ASTNode(t) {} };
-class DiveNode : public ASTNode { public: DiveNode(std::string t) : ASTNode(t) {} };
-class RemNode : public ASTNode { public: RemNode(std::string t) : ASTNode(t) {} };
-class LeNode : public ASTNode { public: LeNode(std::string t) : ASTNode(t) {} };
-class ConsNode : public ASTNode { public: ConsNode(std::string t) : ASTNode(t) {} };
-class EqualNode : public ASTNode { public: EqualNode(std::string t) : ASTNode(t) {} };
+class AddNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Add; AddNode() : ASTNode(Kind) {} };
+class SubNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Sub; SubNode() : ASTNode(Kind) {} };
+class MulNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Mul; MulNode() : ASTNode(Kind) {} };
+class DiveNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Dive; DiveNode() : ASTNode(Kind) {} };
+class RemNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Rem; RemNode() : ASTNode(Kind) {} };
+class LeNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Le; LeNode() : ASTNode(Kind) {} };
+class ConsNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Cons; ConsNode() : ASTNode(Kind) {} };
+class EqualNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Equal; EqualNode() : ASTNode(Kind) {} };
 
 // ternary
-class CondNode : public ASTNode { public: CondNode(std::string t) : ASTNode(t) {} };
+class CondNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Cond; CondNode() : ASTNode(Kind) {} };
 
 // other Nodes
-class LambdaNode : public ASTNode { public: LambdaNode(std::string t) : ASTNode(t) {} };
+class LambdaNode : public ASTNode {
+    // (y e): параметры и тело, общие для всех замыканий этой lambda
+    Ref<ASTNode> function_part;
+public:
+    static constexpr NodeKind Kind = NodeKind::Lambda;
+    LambdaNode() : ASTNode(Kind) {}
+    Ref<ASTNode> getFunctionPart();
+};
 class FuncClosureNode : public ASTNode { 
+    // окружение, в котором вычислена lambda (n v)
+    Env env;
 public: 
-    FuncClosureNode(std::string t) : ASTNode(t) {} 
+    static constexpr NodeKind Kind = NodeKind::FuncClosure;
+    FuncClosureNode() : ASTNode(Kind) {} 
+    FuncClosureNode(Ref<ASTNode> function_part, Env e) : ASTNode(Kind), env(e) {
+        addStatement(function_part);
+    }
+
+    const Env& getEnv() const { return env; }
+
     void printFlat(int depth = 0, std::ostream& os = std::cout) override {
         os << "(";
         if (!getStatements().empty()) {
@@ -139,36 +382,67 @@ public:
                 os << " ";
                 stmt->printFlat(depth, os);
             }
+
+            // контекст (n v) печатается сплющенным, как список связываний
+            os << " ( (";
+            for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+                for (const auto& name : frame->names->getStatements()) {
+                    os << " ";
+                    name->printFlat(depth, os);
+                }
+            }
+            os << ") (";
+            for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+                for (const auto& value : frame->values) {
+                    os << " ";
+                    value.printFlat(depth, os);
+                }
+            }
+            os << "))";
         }
         os << ")";
     }
 };
-class LetNode : public ASTNode { public: LetNode(std::string t) : ASTNode(t) {} };
-class LetrecNode : public ASTNode { public: LetrecNode(std::string t) : ASTNode(t) {} };
+class LetNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Let; LetNode() : ASTNode(Kind) {} };
+class LetrecNode : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::Letrec; LetrecNode() : ASTNode(Kind) {} };
 
 
 class LiteralInt : public ASTNode {
-    cBigNumber value;
+    // число, помещающееся в машинное слово, хранится в small; big заводится только при переполнении
+    long long small = 0;
+    std::unique_ptr<cBigNumber> big;
 public:
-    void printValue(std::ostream& os = std::cout) const override { os << value; }
-    cBigNumber getValue() { return value; }
-    LiteralInt(std::string t, cBigNumber v) : ASTNode(t), value(v) {}
+    static constexpr NodeKind Kind = NodeKind::LiteralInt;
+    void printValue(std::ostream& os = std::cout) const override {
+        if (big) { os << *big; }
+        else { os << small; }
+    }
+    bool isSmall() const { return !big; }
+    long long getSmall() const { return small; }
+    cBigNumber getValue() const { return big ? *big : cBigNumber((CBNL)small); }
+    LiteralInt(long long v) : ASTNode(Kind), small(v) {}
+    LiteralInt(const cBigNumber& v) : ASTNode(Kind) {
+        if (v.bits() < (CBNL)(CHAR_BIT * sizeof(long long))) { small = (long long)v.toCBNL(); }
+        else { big = std::make_unique<cBigNumber>(v); }
+    }
 };
 
 class LiteralBool : public ASTNode {
     bool value;
 public:
+    static constexpr NodeKind Kind = NodeKind::LiteralBool;
     void printValue(std::ostream& os = std::cout) const override {
         if (value) { os << "TRUE"; }
         else { os << "FALSE"; }
     }
     bool getValue() { return value; }
-    LiteralBool(std::string t, bool v) : ASTNode(t), value(v) {}
+    LiteralBool(bool v) : ASTNode(Kind), value(v) {}
 };
 
 class ListNode : public ASTNode { 
 public: 
-    ListNode(std::string t) : ASTNode(t) {}
+    static constexpr NodeKind Kind = NodeKind::List;
+    ListNode() : ASTNode(Kind) {}
     void printFlat(int depth = 0, std::ostream& os = std::cout) override {
         os << "(";
         if (!getStatements().empty()) {
@@ -181,15 +455,204 @@ public:
     }
 };
 
-class LiteralNil : public ASTNode { public: LiteralNil(std::string t) : ASTNode(t) {} };
+class LiteralNil : public ASTNode { public: static constexpr NodeKind Kind = NodeKind::LiteralNil; LiteralNil() : ASTNode(Kind) {} };
+
+// Cons-ячейка, из которых строятся списки во время вычисления. Хвост (PairNode или NIL)
+// разделяется между списками, поэтому cons, car и cdr выполняются за O(1).
+class PairNode : public ASTNode {
+public:
+    static constexpr NodeKind Kind = NodeKind::Pair;
+    PairNode(Value car, Value cdr) : ASTNode(Kind) {
+        openCells(std::move(car), std::move(cdr));
+    }
+
+    ~PairNode() {
+        // хвост освобождается в цикле, а не рекурсивно: длинный список не переполнит стек
+        Value tail = std::move(cell(1));
+        while (tail.isNode() && tail.node()->getKind() == Kind && refCount(tail.node()) == 1) {
+            Value next = std::move(static_cast<PairNode*>(tail.node())->cell(1));
+            tail = std::move(next);
+        }
+        closeCells();
+    }
+
+    const Value& getCar() const { return cell(0); }
+    const Value& getCdr() const { return cell(1); }
+
+    void print(int indent = 0, std::ostream& os = std::cout) const override {
+        std::string indentStr = ""; 
+        for (int i = 0; i < indent-1; i++) {indentStr += "    ";} 
+
+        os << indentStr << "";
+        this->printValue(os);
+        os << '\n';
+
+        const PairNode* p = this;
+        for (;;) {
+            p->getCar().print(indent + 2, os);
+            const Value& next = p->getCdr();
+            if (!next.isNode() || next.node()->getKind() != Kind) {
+                break;
+            }
+            p = static_cast<const PairNode*>(next.node());
+        }
+    }
+
+    void printFlat(int depth = 0, std::ostream& os = std::cout) override {
+        os << "(";
+        const PairNode* p = this;
+        for (;;) {
+            os << " ";
+            p->getCar().printFlat(depth, os);
+            const Value& next = p->getCdr();
+            if (!next.isNode() || next.node()->getKind() != Kind) {
+                break;
+            }
+            p = static_cast<const PairNode*>(next.node());
+        }
+        os << ")";
+    }
+};
+
+inline Ref<ASTNode> LambdaNode::getFunctionPart() {
+    if (!function_part) {
+        int size = getStatementCount();
+        auto params = makeRef<ListNode>();
+        for (int i = 0; i < size-1; i++) {
+            params->addStatement(getStatement(i));
+        }
+        function_part = makeRef<ListNode>();
+        function_part->addStatement(params);
+        function_part->addStatement(getStatement(size-1));
+    }
+    return function_part;
+}
 
 class Identifier : public ASTNode {
-    std::string value;
+    Symbol value;
+    // лексический адрес (номер кадра окружения, номер ячейки в кадре),
+    // вычисляется Resolver; -1, если переменная не разрешена
+    int depth = -1;
+    int slot = -1;
 public:
-    void printValue(std::ostream& os = std::cout) const override { os << value; }
-    std::string getValue() { return value; }
-    Identifier(std::string t, std::string v) : ASTNode(t), value(v) {}
+    static constexpr NodeKind Kind = NodeKind::Identifier;
+    void printValue(std::ostream& os = std::cout) const override { os << *value; }
+    const std::string& getValue() const { return *value; }
+    Symbol getSymbol() const { return value; }
+    Identifier(Symbol v) : ASTNode(Kind), value(v) {}
+    Identifier(const std::string& v) : ASTNode(Kind), value(intern(v)) {}
+
+    bool isResolved() const { return depth >= 0; }
+    int getDepth() const { return depth; }
+    int getSlot() const { return slot; }
+    void setLocation(int d, int s) { depth = d; slot = s; }
 };
 
+// Общие неизменяемые константы: NIL, TRUE, FALSE и малые целые не выделяются заново
+// при каждом вычислении или разборе, а берутся из заранее созданных экземпляров.
+constexpr long long SMALL_INT_MIN = -128;
+constexpr long long SMALL_INT_MAX = 1023;
+
+inline Ref<LiteralNil> makeNil() {
+    static const auto nil = makeRef<LiteralNil>();
+    return nil;
+}
+
+inline Ref<LiteralBool> makeBool(bool v) {
+    static const auto true_value = makeRef<LiteralBool>(true);
+    static const auto false_value = makeRef<LiteralBool>(false);
+    return v ? true_value : false_value;
+}
+
+inline Ref<LiteralInt> makeInt(long long v) {
+    static const auto cache = [] {
+        std::vector<Ref<LiteralInt>> c;
+        for (long long i = SMALL_INT_MIN; i <= SMALL_INT_MAX; i++) {
+            c.push_back(makeRef<LiteralInt>(i));
+        }
+        return c;
+    }();
+    if (v >= SMALL_INT_MIN && v <= SMALL_INT_MAX) {
+        return cache[v - SMALL_INT_MIN];
+    }
+    return makeRef<LiteralInt>(v);
+}
+
+inline Ref<LiteralInt> makeInt(const cBigNumber& v) {
+    if (v.bits() < (CBNL)(CHAR_BIT * sizeof(long long))) {
+        return makeInt((long long)v.toCBNL());
+    }
+    return makeRef<LiteralInt>(v);
+}
+
+inline Ref<LiteralInt> AST::makeInt(const cBigNumber& v) {
+    if (v.bits() < (CBNL)(CHAR_BIT * sizeof(long long))) {
+        long long small = (long long)v.toCBNL();
+        if (small >= SMALL_INT_MIN && small <= SMALL_INT_MAX) {
+            return syntax_tree::makeInt(small);
+        }
+        return make<LiteralInt>(small);
+    }
+    return make<LiteralInt>(v);
+}
+
+
+inline Value Value::integer(long long v) {
+    return fitsFixnum(v) ? fixnum(v) : box(syntax_tree::makeInt(v));
+}
 
-};
\ No newline at end of file
+inline Value Value::integer(const cBigNumber& v) {
+    if (v.bits() < (CBNL)(CHAR_BIT * sizeof(long long))) {
+        return integer((long long)v.toCBNL());
+    }
+    return box(syntax_tree::makeInt(v));
+}
+
+// константа из текста программы или из quote - в самом коротком виде
+inline Value Value::fromNode(const Ref<ASTNode>& node) {
+    switch (node->getKind()) {
+        case NodeKind::LiteralInt: {
+            auto n = static_cast<LiteralInt*>(node.get());
+            return (n->isSmall() && fitsFixnum(n->getSmall())) ? fixnum(n->getSmall()) : box(node);
+        }
+        case NodeKind::LiteralBool:
+            return boolean(static_cast<LiteralBool*>(node.get())->getValue());
+        case NodeKind::LiteralNil:
+            return nil();
+        case NodeKind::Identifier:
+            return symbol(static_cast<Identifier*>(node.get())->getSymbol());
+        default:
+            return box(node);
+    }
+}
+
+// узел для печати и для результата AST
+inline Ref<ASTNode> Value::toNode() const {
+    if (isFixnum()) return syntax_tree::makeInt((long long)fixnumValue());
+    if (isSymbol()) return makeRef<Identifier>(getSymbol());
+    if (isNil()) return makeNil();
+    if (isTrue() || isFalse()) return makeBool(isTrue());
+    return Ref<ASTNode>(pointer());
+}
+
+inline NodeKind Value::getKind() const {
+    if (isFixnum()) return NodeKind::LiteralInt;
+    if (isSymbol()) return NodeKind::Identifier;
+    if (isNil()) return NodeKind::LiteralNil;
+    if (isTrue() || isFalse()) return NodeKind::LiteralBool;
+    return pointer()->getKind();
+}
+
+inline bool Value::isList() const { return isNode() && pointer()->isList(); }
+
+inline void Value::print(int indent, std::ostream& os) const {
+    if (isNode()) pointer()->print(indent, os);
+    else toNode()->print(indent, os);
+}
+
+inline void Value::printFlat(int depth, std::ostream& os) const {
+    if (isNode()) pointer()->printFlat(depth, os);
+    else toNode()->printFlat(depth, os);
+}
+
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "Ref.h"
+#include <vector>
+
+// Память для узлов, которые строит парсер: выделение - сдвиг указателя внутри больших
+// блоков, освобождение отдельных узлов ничего не делает, а блоки освобождаются все
+// разом, когда уничтожена арена. Арена однопоточная, как и всё дерево. Каждый узел
+// из арены держит на неё ссылку, так что арена живёт, пока жив хоть один её узел.
+class Arena {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t block_size = 0;
+    char* next = nullptr;
+    size_t left = 0;
+
+    // каждый следующий блок вдвое больше: крупная программа занимает лишь несколько блоков
+    void grow(size_t size) {
+        block_size = std::max(block_size ? 2 * block_size : BLOCK_SIZE, size);
+        blocks.emplace_back(new char[block_size]);
+        next = blocks.back().get();
+        left = block_size;
+    }
+
+public:
+    uint32_t refs = 0;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(next) % align) % align;
+        if (pad + size > left) {
+            grow(size + align);
+            pad = (align - reinterpret_cast<uintptr_t>(next) % align) % align;
+        }
+        void* p = next + pad;
+        next += pad + size;
+        left -= pad + size;
+        return p;
+    }
+};
+
+inline void refRetain(Arena* arena) { arena->refs++; }
+inline void refRelease(Arena* arena) {
+    if (--arena->refs == 0) delete arena;
+}
@@ -0,0 +1,193 @@
+#include "CekEmulator.h"
+
+syntax_tree::AST CekEmulator::eval(syntax_tree::AST ast) {
+    Env env = nullptr;
+    Value root = run(ast.getRoot(), env);
+    return syntax_tree::AST(root.toNode());
+}
+
+void CekEmulator::push(std::vector<Continuation>& stack, ContinuationKind kind, const Node& node, const Env& env) {
+    if (max_depth != 0 && stack.size() >= max_depth) {
+        throw std::runtime_error("Continuation stack overflow: depth limit " + std::to_string(max_depth) + " exceeded");
+    }
+    stack.emplace_back(kind, node, env);
+}
+
+Value CekEmulator::run(Node e, Env env) {
+    using syntax_tree::NodeKind;
+
+    std::vector<Continuation> stack;
+    Value value;
+    bool returning = false;
+
+    for (;;) {
+        if (!returning) {
+            // спуск: выражение либо сразу даёт значение, либо откладывает продолжение
+            if (!e) {
+                // пустое дерево остаётся после синтаксической ошибки
+                throw std::runtime_error("Unknown node type");
+            }
+            switch (e->getKind()) {
+                case NodeKind::LiteralInt:
+                case NodeKind::LiteralBool:
+                case NodeKind::LiteralNil:
+                    value = Value::fromNode(e);
+                    returning = true;
+                    break;
+                case NodeKind::Identifier:
+                    value = evalIdentifier(refCast<syntax_tree::Identifier>(e), env);
+                    returning = true;
+                    break;
+                case NodeKind::Quote:
+                    value = evalQuoteNode(refCast<syntax_tree::QuoteNode>(e));
+                    returning = true;
+                    break;
+                case NodeKind::Lambda:
+                    value = evalLambdaNode(refCast<syntax_tree::LambdaNode>(e), env);
+                    returning = true;
+                    break;
+                case NodeKind::Car:
+                case NodeKind::Cdr:
+                case NodeKind::Atom:
+                case NodeKind::Literal:
+                    push(stack, ContinuationKind::Unary, e, env);
+                    e = e->getStatement(0);
+                    break;
+                case NodeKind::Add:
+                case NodeKind::Sub:
+                case NodeKind::Mul:
+                case NodeKind::Dive:
+                case NodeKind::Rem:
+                case NodeKind::Le:
+                case NodeKind::Cons:
+                case NodeKind::Equal:
+                    push(stack, ContinuationKind::BinaryLeft, e, env);
+                    e = e->getStatement(0);
+                    break;
+                case NodeKind::Cond:
+                    push(stack, ContinuationKind::CondTest, e, env);
+                    e = e->getStatement(0);
+                    break;
+                case NodeKind::Let:
+                    if (e->getStatementCount() == 1) {
+                        auto empty = makeRef<syntax_tree::ListNode>();
+                        env = makeRef<Frame>(empty, std::vector<Value>(), env);
+                        e = e->getStatement(0);
+                        break;
+                    }
+                    push(stack, ContinuationKind::LetBind, e, env);
+                    stack.back().index = 1;
+                    e = e->getStatement(1)->getStatement(1);
+                    break;
+                case NodeKind::Letrec:
+                    env = letrecFrame(refCast<syntax_tree::LetrecNode>(e), env);
+                    if (e->getStatementCount() == 1) {
+                        e = e->getStatement(0);
+                        break;
+                    }
+                    push(stack, ContinuationKind::LetrecBind, e, env);
+                    stack.back().index = 1;
+                    e = e->getStatement(1)->getStatement(1);
+                    break;
+                case NodeKind::List:
+                    push(stack, ContinuationKind::CallArg, e, env);
+                    stack.back().index = 1;
+                    if (e->getStatementCount() == 1) {
+                        stack.back().kind = ContinuationKind::CallFunction;
+                        e = e->getStatement(0);
+                    }
+                    else {
+                        e = e->getStatement(1);
+                    }
+                    break;
+                default:
+                    throw std::runtime_error("Unknown node type");
+            }
+            continue;
+        }
+
+        // возврат: значение передаётся верхнему продолжению
+        if (stack.empty()) {
+            return value;
+        }
+        Continuation& k = stack.back();
+        switch (k.kind) {
+            case ContinuationKind::Unary:
+                value = applyUnary(k.node->getKind(), value);
+                stack.pop_back();
+                break;
+            case ContinuationKind::BinaryLeft:
+                k.kind = ContinuationKind::BinaryRight;
+                k.first = value;
+                e = k.node->getStatement(1);
+                env = k.env;
+                returning = false;
+                break;
+            case ContinuationKind::BinaryRight:
+                value = applyBinary(k.node->getKind(), k.first, value);
+                stack.pop_back();
+                break;
+            case ContinuationKind::CondTest:
+                if (!value.isTrue() && !value.isFalse()) {
+                    throw std::runtime_error("Cond error!");
+                }
+                e = k.node->getStatement(value.isTrue() ? 1 : 2);
+                env = k.env;
+                stack.pop_back();
+                returning = false;
+                break;
+            case ContinuationKind::LetBind:
+                k.values.push_back(std::move(value));
+                if (++k.index < k.node->getStatementCount()) {
+                    e = k.node->getStatement(k.index)->getStatement(1);
+                    env = k.env;
+                }
+                else {
+                    // nv refresh: связывания видны только в теле let
+                    auto names = makeRef<syntax_tree::ListNode>();
+                    for (size_t i = 1; i < k.node->getStatementCount(); i++) {
+                        names->addStatement(k.node->getStatement(i)->getStatement(0));
+                    }
+                    env = makeRef<Frame>(names, std::move(k.values), k.env);
+                    e = k.node->getStatement(0);
+                    stack.pop_back();
+                }
+                returning = false;
+                break;
+            case ContinuationKind::LetrecBind:
+                k.values.push_back(std::move(value));
+                env = k.env;
+                if (++k.index < k.node->getStatementCount()) {
+                    e = k.node->getStatement(k.index)->getStatement(1);
+                }
+                else {
+                    complete(env, k.values);
+                    e = k.node->getStatement(0);
+                    stack.pop_back();
+                }
+                returning = false;
+                break;
+            case ContinuationKind::CallArg:
+                k.values.push_back(std::move(value));
+                if (++k.index < k.node->getStatementCount()) {
+                    e = k.node->getStatement(k.index);
+                }
+                else {
+                    k.kind = ContinuationKind::CallFunction;
+                    e = k.node->getStatement(0);
+                }
+                env = k.env;
+                returning = false;
+                break;
+            case ContinuationKind::CallFunction: {
+                // продолжение снимается до входа в тело: хвостовой вызов не растит стек
+                auto args = std::move(k.values);
+                env = k.env;
+                stack.pop_back();
+                e = enterClosure(value, std::move(args), env);
+                returning = false;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "Emulator.h"
+
+// Вычислитель в стиле CEK: продолжения хранятся в куче (std::vector), а не на стеке C++,
+// поэтому глубина нехвостовой рекурсии ограничена только max_depth.
+class CekEmulator : public Emulator {
+private:
+    enum class ContinuationKind : unsigned char {
+        Unary,        // (op e): ждём аргумент
+        BinaryLeft,   // (op e1 e2): ждём e1
+        BinaryRight,  // (op e1 e2): e1 в first, ждём e2
+        CondTest,     // (cond e1 e2 e3): ждём e1
+        LetBind,      // (let e (x1 e1) ...): ждём e_index
+        LetrecBind,   // (letrec e (x1 e1) ...): ждём e_index, env уже содержит OMEGA
+        CallArg,      // (e0 e1 ... ek): ждём e_index
+        CallFunction  // (e0 e1 ... ek): аргументы в values, ждём e0
+    };
+
+    struct Continuation {
+        ContinuationKind kind;
+        Node node;
+        Env env;
+        size_t index = 0;
+        Value first;
+        std::vector<Value> values;
+
+        Continuation(ContinuationKind k, Node n, Env e) : kind(k), node(n), env(e) {}
+    };
+
+    size_t max_depth; // 0 - без ограничения
+
+    Value run(Node e, Env env);
+    void push(std::vector<Continuation>& stack, ContinuationKind kind, const Node& node, const Env& env);
+
+public:
+    explicit CekEmulator(size_t max_depth = 0) : max_depth(max_depth) {}
+
+    syntax_tree::AST eval(syntax_tree::AST ast) override;
+};
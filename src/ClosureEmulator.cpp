@@ -0,0 +1,194 @@
+#include "ClosureEmulator.h"
+
+syntax_tree::AST ClosureEmulator::eval(syntax_tree::AST ast) {
+    const Compiled* root = convert(ast.getRoot());
+    Env env = nullptr;
+    return syntax_tree::AST(run(root, env).toNode());
+}
+
+Value ClosureEmulator::run(const Compiled* c, Env env) {
+    for (;;) {
+        const Compiled* next = nullptr;
+        Value value = c->code(env, next);
+        if (!next) {
+            return value;
+        }
+        c = next;
+    }
+}
+
+const ClosureEmulator::Compiled* ClosureEmulator::make(Code code) {
+    program.push_back(std::make_unique<Compiled>(Compiled{std::move(code)}));
+    return program.back().get();
+}
+
+template <class Op>
+const ClosureEmulator::Compiled* ClosureEmulator::unary(const Compiled* arg, Op op) {
+    return make([this, arg, op](Env& env, const Compiled*&) -> Value {
+        return op(run(arg, env));
+    });
+}
+
+template <class Op>
+const ClosureEmulator::Compiled* ClosureEmulator::binary(const Compiled* left, const Compiled* right, Op op) {
+    return make([this, left, right, op](Env& env, const Compiled*&) -> Value {
+        auto l = run(left, env);
+        auto r = run(right, env);
+        return op(l, r);
+    });
+}
+
+const ClosureEmulator::Compiled* ClosureEmulator::convert(const Node& e) {
+    using syntax_tree::NodeKind;
+
+    // пустое дерево остаётся после синтаксической ошибки
+    if (!e) {
+        throw std::runtime_error("Unknown node type");
+    }
+    switch (e->getKind()) {
+        case NodeKind::LiteralInt:
+        case NodeKind::LiteralBool:
+        case NodeKind::LiteralNil: {
+            Value v = Value::fromNode(e);
+            return make([v](Env&, const Compiled*&) -> Value { return v; });
+        }
+        case NodeKind::Identifier: {
+            auto id = refCast<syntax_tree::Identifier>(e);
+            if (!id->isResolved()) {
+                // свободная переменная: поиск по имени сообщит об ошибке, как в Emulator
+                return make([this, id](Env& env, const Compiled*&) -> Value { return assoc(id, env); });
+            }
+            int depth = id->getDepth();
+            int slot = id->getSlot();
+            return make([depth, slot](Env& env, const Compiled*&) -> Value {
+                Frame* frame = env.get();
+                for (int i = depth; i > 0; --i) {
+                    frame = frame->parent.get();
+                }
+                return frame->values[slot];
+            });
+        }
+        case NodeKind::Quote: {
+            // данные переводятся в cons-ячейки один раз, при переводе
+            Value data = evalQuoteNode(refCast<syntax_tree::QuoteNode>(e));
+            return make([data](Env&, const Compiled*&) -> Value { return data; });
+        }
+        case NodeKind::Car:
+            return unary(convert(e->getStatement(0)), [this](const Value& v) -> Value { return applyCar(v); });
+        case NodeKind::Cdr:
+            return unary(convert(e->getStatement(0)), [this](const Value& v) -> Value { return applyCdr(v); });
+        case NodeKind::Atom:
+            return unary(convert(e->getStatement(0)), [this](const Value& v) -> Value { return applyAtom(v); });
+        case NodeKind::Literal:
+            return unary(convert(e->getStatement(0)), [this](const Value& v) -> Value { return applyLiteral(v); });
+        case NodeKind::Add:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyAdd(l, r); });
+        case NodeKind::Sub:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applySub(l, r); });
+        case NodeKind::Mul:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyMul(l, r); });
+        case NodeKind::Dive:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyDive(l, r); });
+        case NodeKind::Rem:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyRem(l, r); });
+        case NodeKind::Le:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyLe(l, r); });
+        case NodeKind::Cons:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyCons(l, r); });
+        case NodeKind::Equal:
+            return binary(convert(e->getStatement(0)), convert(e->getStatement(1)), [this](const Value& l, const Value& r) -> Value { return applyEqual(l, r); });
+        case NodeKind::Cond: {
+            const Compiled* test = convert(e->getStatement(0));
+            const Compiled* then_branch = convert(e->getStatement(1));
+            const Compiled* else_branch = convert(e->getStatement(2));
+            return make([this, test, then_branch, else_branch](Env& env, const Compiled*& next) -> Value {
+                auto value = run(test, env);
+                if (value.isTrue() || value.isFalse()) {
+                    next = value.isTrue() ? then_branch : else_branch;
+                    return Value();
+                }
+                throw std::runtime_error("Cond error!");
+            });
+        }
+        case NodeKind::Lambda: {
+            auto function_part = refCast<syntax_tree::LambdaNode>(e)->getFunctionPart();
+            const Compiled* body = convert(function_part->getStatement(1));
+            return make([function_part, body](Env& env, const Compiled*&) -> Value {
+                return Value::box(makeRef<CompiledClosureNode>(function_part, env, body));
+            });
+        }
+        case NodeKind::Let:
+            return convertLet(e, false);
+        case NodeKind::Letrec:
+            return convertLet(e, true);
+        case NodeKind::List:
+            return convertCall(refCast<syntax_tree::ListNode>(e));
+        default:
+            break;
+    }
+    throw std::runtime_error("Unknown node type");
+}
+
+const ClosureEmulator::Compiled* ClosureEmulator::convertCall(const ListNode& call) {
+    std::vector<const Compiled*> args;
+    for (size_t i = 1; i < call->getStatementCount(); i++) {
+        args.push_back(convert(call->getStatement(i)));
+    }
+    const Compiled* function = convert(call->getStatement(0));
+
+    return make([this, args, function](Env& env, const Compiled*& next) -> Value {
+        // аргументы, затем e0 - в том же порядке, что и evalFuncCall
+        std::vector<Value> values;
+        values.reserve(args.size());
+        for (const Compiled* arg : args) {
+            values.push_back(run(arg, env));
+        }
+        auto closure = run(function, env);
+        enterClosure(closure, std::move(values), env);
+        // все замыкания с телом здесь создаёт ветка Lambda, OMEGA отвергает enterClosure
+        next = static_cast<CompiledClosureNode*>(closure.node())->getBody();
+        return Value();
+    });
+}
+
+const ClosureEmulator::Compiled* ClosureEmulator::convertLet(const Node& let, bool recursive) {
+    // имена кадра не меняются, поэтому один список разделяется всеми кадрами этой формы
+    auto names = makeRef<syntax_tree::ListNode>();
+    std::vector<const Compiled*> exprs;
+    for (size_t i = 1; i < let->getStatementCount(); i++) {
+        auto statement = let->getStatement(i);
+        names->addStatement(statement->getStatement(0));
+        exprs.push_back(convert(statement->getStatement(1)));
+    }
+    const Compiled* body = convert(let->getStatement(0));
+
+    if (!recursive) {
+        return make([this, names, exprs, body](Env& env, const Compiled*& next) -> Value {
+            std::vector<Value> values;
+            values.reserve(exprs.size());
+            for (const Compiled* expr : exprs) {
+                values.push_back(run(expr, env));
+            }
+            env = makeRef<Frame>(names, std::move(values), env);
+            next = body;
+            return Value();
+        });
+    }
+    return make([this, names, exprs, body](Env& env, const Compiled*& next) -> Value {
+        std::vector<Value> values;
+        for (size_t i = 0; i < exprs.size(); i++) {
+            values.push_back(Value::box(makeRef<syntax_tree::FuncClosureNode>()));
+        }
+        Env new_env = makeRef<Frame>(names, std::move(values), env);
+
+        std::vector<Value> z;
+        for (const Compiled* expr : exprs) {
+            z.push_back(run(expr, new_env));
+        }
+        complete(new_env, z);
+
+        env = new_env;
+        next = body;
+        return Value();
+    });
+}
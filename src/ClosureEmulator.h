@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Emulator.h"
+
+// Вычислитель, который перед выполнением один раз переводит AST в дерево функций C++:
+// каждая держит прямые указатели на уже переведённые подвыражения, а разбор вида узла,
+// поиск детей через getStatement(i) и адреса переменных (Resolver) остаются во времени
+// перевода. Значения, окружения и сообщения об ошибках те же, что у Emulator.
+class ClosureEmulator : public Emulator {
+private:
+    struct Compiled;
+
+    // Выполняет выражение в env. Хвостовая форма (cond, let, letrec, вызов) вместо значения
+    // возвращает пустое Value: она подменяет env и кладёт в next выражение, которое run вычислит
+    // следующим в том же цикле, поэтому хвостовая рекурсия не растит стек C++.
+    typedef std::function<Value(Env& env, const Compiled*& next)> Code;
+
+    struct Compiled {
+        Code code;
+    };
+
+    // замыкание с переведённым телом; для печати и EQUAL это обычный FuncClosureNode
+    class CompiledClosureNode : public syntax_tree::FuncClosureNode {
+        const Compiled* body;
+    public:
+        CompiledClosureNode(Ref<syntax_tree::ASTNode> function_part, Env env, const Compiled* body)
+            : FuncClosureNode(function_part, env), body(body) {}
+        const Compiled* getBody() const { return body; }
+    };
+
+    std::vector<std::unique_ptr<Compiled>> program;
+
+    const Compiled* make(Code code);
+    const Compiled* convert(const Node& e);
+    const Compiled* convertCall(const ListNode& call);
+    const Compiled* convertLet(const Node& let, bool recursive);
+    template <class Op> const Compiled* unary(const Compiled* arg, Op op);
+    template <class Op> const Compiled* binary(const Compiled* left, const Compiled* right, Op op);
+    Value run(const Compiled* c, Env env);
+
+public:
+    syntax_tree::AST eval(syntax_tree::AST ast) override;
+};
@@ -0,0 +1,149 @@
+#include "Collector.h"
+#include <algorithm>
+#include <type_traits>
+
+using syntax_tree::ASTNode;
+using syntax_tree::NodeKind;
+
+bool Collector::traced(ASTNode* node) {
+    // остальные значения (числа, символы, код программы) к кадрам не ведут
+    NodeKind kind = node->getKind();
+    return kind == NodeKind::List || kind == NodeKind::Pair || kind == NodeKind::FuncClosure;
+}
+
+template <class F>
+void Collector::edges(Frame* frame, F visit) {
+    // имена - идентификаторы из текста программы, непосредственные значения без ссылок
+    for (const auto& value : frame->values) {
+        if (value.isNode()) {
+            visit(value.node());
+        }
+    }
+    if (frame->parent) {
+        visit(frame->parent.get());
+    }
+}
+
+template <class F>
+void Collector::edges(ASTNode* node, F visit) {
+    switch (node->getKind()) {
+        case NodeKind::List:
+            for (const auto& item : node->getStatements()) {
+                visit(item.get());
+            }
+            break;
+        case NodeKind::Pair: {
+            auto pair = static_cast<syntax_tree::PairNode*>(node);
+            if (pair->getCar().isNode()) {
+                visit(pair->getCar().node());
+            }
+            if (pair->getCdr().isNode()) {
+                visit(pair->getCdr().node());
+            }
+            break;
+        }
+        case NodeKind::FuncClosure: {
+            // функциональная часть - код программы, к кадрам ведёт только окружение
+            const Env& env = static_cast<syntax_tree::FuncClosureNode*>(node)->getEnv();
+            if (env) {
+                visit(env.get());
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Collector::subtractInternal() {
+    for (Frame* frame = Frame::all; frame; frame = frame->next) {
+        frame->gc_refs = frame->refs;
+    }
+    // после обхода gc_refs - число ссылок извне графа
+    auto visit = [&](auto* target) {
+        if constexpr (std::is_same<decltype(target), Frame*>::value) {
+            target->gc_refs--;
+        }
+        else if (traced(target)) {
+            auto it = nodes.find(target);
+            if (it == nodes.end()) {
+                nodes.emplace(target, syntax_tree::refCount(target) - 1);
+                pending_nodes.push_back(target);
+            }
+            else {
+                it->second--;
+            }
+        }
+    };
+    for (Frame* frame = Frame::all; frame; frame = frame->next) {
+        edges(frame, visit);
+    }
+    while (!pending_nodes.empty()) {
+        ASTNode* node = pending_nodes.back();
+        pending_nodes.pop_back();
+        edges(node, visit);
+    }
+}
+
+void Collector::markReachable() {
+    // ненулевой gc_refs - корень или уже помеченный объект
+    for (Frame* frame = Frame::all; frame; frame = frame->next) {
+        if (frame->gc_refs > 0) {
+            pending_frames.push_back(frame);
+        }
+    }
+    for (const auto& node : nodes) {
+        if (node.second > 0) {
+            pending_nodes.push_back(node.first);
+        }
+    }
+    auto visit = [&](auto* target) {
+        if constexpr (std::is_same<decltype(target), Frame*>::value) {
+            if (target->gc_refs == 0) {
+                target->gc_refs = 1;
+                pending_frames.push_back(target);
+            }
+        }
+        else if (traced(target)) {
+            uint32_t& gc_refs = nodes.at(target);
+            if (gc_refs == 0) {
+                gc_refs = 1;
+                pending_nodes.push_back(target);
+            }
+        }
+    };
+    while (!pending_frames.empty() || !pending_nodes.empty()) {
+        if (!pending_frames.empty()) {
+            Frame* frame = pending_frames.back();
+            pending_frames.pop_back();
+            edges(frame, visit);
+        }
+        else {
+            ASTNode* node = pending_nodes.back();
+            pending_nodes.pop_back();
+            edges(node, visit);
+        }
+    }
+}
+
+void Collector::collect() {
+    subtractInternal();
+    markReachable();
+
+    // недостижимые кадры держатся здесь, пока у всех обнуляются поля: иначе кадр мог бы
+    // освободиться посреди обхода, когда исчезнет последнее замыкание над ним
+    std::vector<Env> garbage;
+    for (Frame* frame = Frame::all; frame; frame = frame->next) {
+        if (frame->gc_refs == 0) {
+            garbage.emplace_back(frame);
+        }
+    }
+    for (const auto& frame : garbage) {
+        frame->names.reset();
+        frame->values.clear();
+        frame->parent.reset();
+    }
+    garbage.clear();
+
+    threshold = std::max(MIN_THRESHOLD, 2 * Frame::live);
+}
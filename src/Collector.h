@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "AST.h"
+
+// Сборщик циклов для вычислителей над AST (Emulator, CekEmulator, ClosureEmulator).
+// Счётчики ссылок (Ref) не освобождают letrec: complete() кладёт в кадр замыкания,
+// которые держат этот же кадр. Любой такой цикл проходит через кадр, поэтому граф
+// сборщика - все живые кадры (Frame::all) и значения между ними: списки, пары и
+// замыкания. Корни - объекты, на которые есть ссылки извне графа (стек вычислителя,
+// локальные переменные C++, AST программы): их счётчик больше числа ссылок изнутри.
+// От корней помечается достижимое, у остальных кадров обнуляются поля, после чего
+// циклы разваливаются и освобождаются обычным счётом ссылок.
+class Collector {
+private:
+    static constexpr size_t MIN_THRESHOLD = 1 << 14;
+
+    // сборка начинается, когда живых кадров больше порога; после неё порог -
+    // удвоенное число выживших, так что работа сборщика линейна в числе кадров
+    inline static size_t threshold = MIN_THRESHOLD;
+
+    std::unordered_map<syntax_tree::ASTNode*, uint32_t> nodes; // gc_refs значений
+    std::vector<syntax_tree::ASTNode*> pending_nodes;
+    std::vector<Frame*> pending_frames;
+
+    static bool traced(syntax_tree::ASTNode* node);
+    template <class F> void edges(Frame* frame, F visit);
+    template <class F> void edges(syntax_tree::ASTNode* node, F visit);
+    void subtractInternal();
+    void markReachable();
+
+public:
+    // точка сборки: вызывается, когда все живые значения вычислителя держат Ref
+    static void safepoint() {
+        if (Frame::live > threshold) {
+            Collector().collect();
+        }
+    }
+    void collect();
+};
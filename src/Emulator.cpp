@@ -1,468 +1,491 @@
 #include "Emulator.h"
+#include "Collector.h"
 #include <iostream>
+#include <sstream>
 
 syntax_tree::AST Emulator::eval(syntax_tree::AST ast) {
-    // Matrix n = {
-    //     {std::make_shared<syntax_tree::Identifier>("Identifier", "a")}
-    // };
-    // Matrix v = {
-    //     {std::make_shared<syntax_tree::LiteralInt>("LiteralInt", 1)}
-    // };
-    Matrix n, v;
-    Node root = eval(ast.getRoot(), n, v);
-    return syntax_tree::AST(root);
+    Env env = nullptr;
+    Value root = eval(ast.getRoot(), env);
+    return syntax_tree::AST(root.toNode());
 }
 
-Node Emulator::eval(Node e, Matrix& n, Matrix& v) {
-    if (auto litInt = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(e)) {
-        return evalLiteralInt(litInt, n, v);
-    }
-    else if (auto litBool = std::dynamic_pointer_cast<syntax_tree::LiteralBool>(e)) {
-        return evalLiteralBool(litBool, n, v);
-    }
-    else if (auto litNil = std::dynamic_pointer_cast<syntax_tree::LiteralNil>(e)) {
-        return evalLiteralNil(litNil, n, v);
-    }
-    else if (auto id = std::dynamic_pointer_cast<syntax_tree::Identifier>(e)) {
-        return evalIdentifier(id, n, v);
-    }
-    else if (auto quote = std::dynamic_pointer_cast<syntax_tree::QuoteNode>(e)) {
-        return evalQuoteNode(quote, n, v);
-    }
-    else if (auto car = std::dynamic_pointer_cast<syntax_tree::CarNode>(e)) {
-        return evalCarNode(car, n, v);
-    }
-    else if (auto cdr = std::dynamic_pointer_cast<syntax_tree::CdrNode>(e)) {
-        return evalCdrNode(cdr, n, v);
-    }
-    else if (auto atom = std::dynamic_pointer_cast<syntax_tree::AtomNode>(e)) {
-        return evalAtomNode(atom, n, v);
-    }
-    else if (auto literal = std::dynamic_pointer_cast<syntax_tree::LiteralNode>(e)) {
-        return evalLiteralNode(literal, n, v);
-    }
-    else if (auto add = std::dynamic_pointer_cast<syntax_tree::AddNode>(e)) {
-        return evalAddNode(add, n, v);
-    }
-    else if (auto sub = std::dynamic_pointer_cast<syntax_tree::SubNode>(e)) {
-        return evalSubNode(sub, n, v);
-    }
-    else if (auto mul = std::dynamic_pointer_cast<syntax_tree::MulNode>(e)) {
-        return evalMulNode(mul, n, v);
-    }
-    else if (auto dive = std::dynamic_pointer_cast<syntax_tree::DiveNode>(e)) {
-        return evalDiveNode(dive, n, v);
-    }
-    else if (auto rem = std::dynamic_pointer_cast<syntax_tree::RemNode>(e)) {
-        return evalRemNode(rem, n, v);
+Value Emulator::eval(Node e, Env env) {
+    using syntax_tree::NodeKind;
+
+    // Формы с хвостовой позицией (cond, let, letrec, вызов функции) не вызывают eval
+    // рекурсивно: они подменяют e и env, и цикл продолжает вычисление в том же кадре C++.
+    for (;;) {
+        // пустое дерево остаётся после синтаксической ошибки
+        if (!e) {
+            throw std::runtime_error("Unknown node type");
+        }
+        switch (e->getKind()) {
+            case NodeKind::LiteralInt:
+            case NodeKind::LiteralBool:
+            case NodeKind::LiteralNil:
+                return Value::fromNode(e);
+            case NodeKind::Identifier:
+                return evalIdentifier(refCast<syntax_tree::Identifier>(e), env);
+            case NodeKind::Quote:
+                return evalQuoteNode(refCast<syntax_tree::QuoteNode>(e));
+            case NodeKind::Car:
+                return evalCarNode(refCast<syntax_tree::CarNode>(e), env);
+            case NodeKind::Cdr:
+                return evalCdrNode(refCast<syntax_tree::CdrNode>(e), env);
+            case NodeKind::Atom:
+                return evalAtomNode(refCast<syntax_tree::AtomNode>(e), env);
+            case NodeKind::Literal:
+                return evalLiteralNode(refCast<syntax_tree::LiteralNode>(e), env);
+            case NodeKind::Add:
+                return evalAddNode(refCast<syntax_tree::AddNode>(e), env);
+            case NodeKind::Sub:
+                return evalSubNode(refCast<syntax_tree::SubNode>(e), env);
+            case NodeKind::Mul:
+                return evalMulNode(refCast<syntax_tree::MulNode>(e), env);
+            case NodeKind::Dive:
+                return evalDiveNode(refCast<syntax_tree::DiveNode>(e), env);
+            case NodeKind::Rem:
+                return evalRemNode(refCast<syntax_tree::RemNode>(e), env);
+            case NodeKind::Le:
+                return evalLeNode(refCast<syntax_tree::LeNode>(e), env);
+            case NodeKind::Cons:
+                return evalConsNode(refCast<syntax_tree::ConsNode>(e), env);
+            case NodeKind::Equal:
+                return evalEqualNode(refCast<syntax_tree::EqualNode>(e), env);
+            case NodeKind::Cond:
+                e = evalCondNode(refCast<syntax_tree::CondNode>(e), env);
+                continue;
+            case NodeKind::Lambda:
+                return evalLambdaNode(refCast<syntax_tree::LambdaNode>(e), env);
+            case NodeKind::Let:
+                e = evalLetNode(refCast<syntax_tree::LetNode>(e), env);
+                continue;
+            case NodeKind::Letrec:
+                e = evalLetrecNode(refCast<syntax_tree::LetrecNode>(e), env);
+                continue;
+            case NodeKind::List:
+                e = evalFuncCall(refCast<syntax_tree::ListNode>(e), env);
+                continue;
+            default:
+                break;
+        }
+
+        throw std::runtime_error("Unknown node type");
     }
-    else if (auto le = std::dynamic_pointer_cast<syntax_tree::LeNode>(e)) {
-        return evalLeNode(le, n, v);
+}
+
+Value Emulator::evalIdentifier(const Identifier& id, const Env& env) {
+    if (id->isResolved()) {
+        Frame* frame = env.get();
+        for (int i = id->getDepth(); i > 0; --i) {
+            frame = frame->parent.get();
+        }
+        return frame->values[id->getSlot()];
     }
-    else if (auto cons = std::dynamic_pointer_cast<syntax_tree::ConsNode>(e)) {
-        return evalConsNode(cons, n, v);
+    return assoc(id, env);
+}
+
+Value Emulator::evalQuoteNode(const QuoteNode& quote) {
+    if (!quote->getData()) {
+        // список из текста программы один раз переводится в cons-ячейки
+        quote->setData(listToPairs(quote->getStatement(0)));
     }
-    else if (auto equal = std::dynamic_pointer_cast<syntax_tree::EqualNode>(e)) {
-        return evalEqualNode(equal, n, v);
+    return quote->getData();
+}
+
+Value Emulator::evalCarNode(const CarNode& car, const Env& env) {
+    auto c = eval(car->getStatement(0), env);
+    return applyCar(c);
+}
+
+Value Emulator::applyCar(Value c) {
+    if (c.isNil()) {
+        return c;
     }
-    else if (auto cond = std::dynamic_pointer_cast<syntax_tree::CondNode>(e)) {
-        return evalCondNode(cond, n, v);
+    else if (c.getKind() == syntax_tree::NodeKind::List) {
+        c = listToPairs(c.toNode());
     }
-    else if (auto lam = std::dynamic_pointer_cast<syntax_tree::LambdaNode>(e)) {
-        return evalLambdaNode(lam, n, v);
+    if (c.isNode() && c.node()->getKind() == syntax_tree::NodeKind::Pair) {
+        return static_cast<syntax_tree::PairNode*>(c.node())->getCar();
     }
-    else if (auto let = std::dynamic_pointer_cast<syntax_tree::LetNode>(e)) {
-        return evalLetNode(let, n, v);
+
+    throw std::runtime_error("Car error: arg must be Nil or List");
+}
+
+Value Emulator::evalCdrNode(const CdrNode& cdr, const Env& env) {
+    auto c = eval(cdr->getStatement(0), env);
+    return applyCdr(c);
+}
+
+Value Emulator::applyCdr(Value c) {
+    if (c.isNil()) {
+        return c;
     }
-    else if (auto letrec = std::dynamic_pointer_cast<syntax_tree::LetrecNode>(e)) {
-        return evalLetrecNode(letrec, n, v);
+    else if (c.getKind() == syntax_tree::NodeKind::List) {
+        c = listToPairs(c.toNode());
     }
-    else if (auto list = std::dynamic_pointer_cast<syntax_tree::ListNode>(e)) {
-        return evalFuncCall(list, n, v);
+    if (c.isNode() && c.node()->getKind() == syntax_tree::NodeKind::Pair) {
+        return static_cast<syntax_tree::PairNode*>(c.node())->getCdr();
     }
 
-    throw std::runtime_error("Unknown node type");
+    throw std::runtime_error("Cdr error: arg must be Nil or List");
 }
 
-LiteralInt Emulator::evalLiteralInt(LiteralInt litInt, Matrix& n, Matrix& v) {
-    return litInt;
+Value Emulator::evalAtomNode(const AtomNode& atom, const Env& env) {
+    auto arg = eval(atom->getStatement(0), env);
+    return applyAtom(arg);
 }
 
-LiteralNil Emulator::evalLiteralNil(LiteralNil litNil, Matrix& n, Matrix& v) {
-    return litNil;
+Value Emulator::applyAtom(const Value& arg) {
+    // true, если аргумент атомарный (не список)
+    return Value::boolean(!arg.isList());
 }
 
-LiteralBool Emulator::evalLiteralBool(LiteralBool litBool, Matrix& n, Matrix& v) {
-    return litBool;
+Value Emulator::evalLiteralNode(const LiteralNode& literal, const Env& env) {
+    auto arg = eval(literal->getStatement(0), env);
+    return applyLiteral(arg);
 }
 
-Node Emulator::evalIdentifier(Identifier id, Matrix& n, Matrix& v) {
-    return assoc(id, n, v);
+Value Emulator::applyLiteral(const Value& arg) {
+    bool isLiteral = arg.isFixnum() || arg.isNil() || arg.isTrue() || arg.isFalse()
+        || (arg.isNode() && arg.node()->getKind() == syntax_tree::NodeKind::LiteralInt);
+    return Value::boolean(isLiteral);
 }
 
-Node Emulator::evalQuoteNode(QuoteNode quote, Matrix& n, Matrix& v) {
-    return quote->getStatement(0);
+bool Emulator::isInteger(const Value& v) {
+    return v.isFixnum() || (v.isNode() && v.node()->getKind() == syntax_tree::NodeKind::LiteralInt);
 }
 
-Node Emulator::evalCarNode(CarNode car, Matrix& n, Matrix& v) {
-    auto c = eval(car->getStatement(0), n, v);
-    
-    if (auto nil = std::dynamic_pointer_cast<syntax_tree::LiteralNil>(c)) {
-        return nil;
-    } 
-    else if (c->getStatementCount() >= 1) {
-        auto first = c->getStatement(0);
-        if (auto list = std::dynamic_pointer_cast<syntax_tree::ListNode>(c)) {
-            return first;
-        }
+cBigNumber Emulator::bigValue(const Value& v) {
+    if (v.isFixnum()) {
+        return cBigNumber((CBNL)v.fixnumValue());
     }
-    
-    throw std::runtime_error("Car error: arg must be Nil or List");
+    return static_cast<syntax_tree::LiteralInt*>(v.node())->getValue();
 }
 
-Node Emulator::evalCdrNode(CdrNode cdr, Matrix& n, Matrix& v) {
-    auto c = eval(cdr->getStatement(0), n, v);
-    
-    if (auto nil = std::dynamic_pointer_cast<syntax_tree::LiteralNil>(c)) {
-        return nil;
-    } else if (auto list = std::dynamic_pointer_cast<syntax_tree::ListNode>(c)) {
-        if (c->getStatementCount() >= 2) {
-            auto new_list = std::make_shared<syntax_tree::ListNode>("LIST");
-            for (size_t i = 1; i < c->getStatementCount(); ++i) {
-                new_list->addStatement(c->getStatement(i));
-            }
-            return new_list;
-        } else if (c->getStatementCount() == 1) {
-            return std::make_shared<syntax_tree::LiteralNil>("NIL");
-        }
-    }
-    
-    throw std::runtime_error("Cdr error: arg must be Nil or List");
-}
+Value Emulator::evalAddNode(const AddNode& add, const Env& env) {
+    auto left = eval(add->getStatement(0), env);
+    auto right = eval(add->getStatement(1), env);
 
-Node Emulator::evalAtomNode(AtomNode atom, Matrix& n, Matrix& v) {
-    auto arg = eval(atom->getStatement(0), n, v);
-    
-    // true, если аргумент атомарный (не список)
-    bool is_atom = (std::dynamic_pointer_cast<syntax_tree::ListNode>(arg) == nullptr);
-    
-    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", is_atom);
+    return applyAdd(left, right);
 }
 
-Node Emulator::evalLiteralNode(LiteralNode literal, Matrix& n, Matrix& v) {
-    auto arg = eval(literal->getStatement(0), n, v);
-    bool isLiteral = false;
-
-    if (auto lit_int = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(arg)) {
-        isLiteral = true;
-    }
-    else if (auto lit_bool = std::dynamic_pointer_cast<syntax_tree::LiteralBool>(arg)) {
-        isLiteral = true;
+Value Emulator::applyAdd(const Value& left, const Value& right) {
+    // сумма двух fixnum из 63 бит не переполняет int64_t
+    if (left.isFixnum() && right.isFixnum()) {
+        return Value::integer((long long)(left.fixnumValue() + right.fixnumValue()));
     }
-    else if (auto lit_nil = std::dynamic_pointer_cast<syntax_tree::LiteralNil>(arg)) {
-        isLiteral = true;
+    if (isInteger(left) && isInteger(right)) {
+        return Value::integer(bigValue(left) + bigValue(right));
     }
-    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", isLiteral);
+    throw std::runtime_error("Add operation requires integer operands");
 }
 
-LiteralInt Emulator::evalAddNode(AddNode add, Matrix& n, Matrix& v) {
-    auto left = eval(add->getStatement(0), n, v);
-    auto right = eval(add->getStatement(1), n, v);
+Value Emulator::evalSubNode(const SubNode& sub, const Env& env) {
+    auto left = eval(sub->getStatement(0), env);
+    auto right = eval(sub->getStatement(1), env);
 
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            return std::make_shared<syntax_tree::LiteralInt>("LiteralInt", left_lit->getValue() + right_lit->getValue());
-        }
-    }
-    throw std::runtime_error("Add operation requires integer operands");
+    return applySub(left, right);
 }
 
-LiteralInt Emulator::evalSubNode(SubNode sub, Matrix& n, Matrix& v) {
-    auto left = eval(sub->getStatement(0), n, v);
-    auto right = eval(sub->getStatement(1), n, v);
-
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            return std::make_shared<syntax_tree::LiteralInt>("LiteralInt", left_lit->getValue() - right_lit->getValue());
-        }
+Value Emulator::applySub(const Value& left, const Value& right) {
+    if (left.isFixnum() && right.isFixnum()) {
+        return Value::integer((long long)(left.fixnumValue() - right.fixnumValue()));
+    }
+    if (isInteger(left) && isInteger(right)) {
+        return Value::integer(bigValue(left) - bigValue(right));
     }
     throw std::runtime_error("Sub operation requires integer operands");
 }
 
-LiteralInt Emulator::evalMulNode(MulNode mul, Matrix& n, Matrix& v) {
-    auto left = eval(mul->getStatement(0), n, v);
-    auto right = eval(mul->getStatement(1), n, v);
+Value Emulator::evalMulNode(const MulNode& mul, const Env& env) {
+    auto left = eval(mul->getStatement(0), env);
+    auto right = eval(mul->getStatement(1), env);
 
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            return std::make_shared<syntax_tree::LiteralInt>("LiteralInt", left_lit->getValue() * right_lit->getValue());
-        }
+    return applyMul(left, right);
+}
+
+Value Emulator::applyMul(const Value& left, const Value& right) {
+    long long result;
+    if (left.isFixnum() && right.isFixnum()
+            && !__builtin_mul_overflow((long long)left.fixnumValue(), (long long)right.fixnumValue(), &result)) {
+        return Value::integer(result);
+    }
+    if (isInteger(left) && isInteger(right)) {
+        return Value::integer(bigValue(left) * bigValue(right));
     }
     throw std::runtime_error("Mul operation requires integer operands");
 }
 
-LiteralInt Emulator::evalDiveNode(DiveNode dive, Matrix& n, Matrix& v) {
-    auto left = eval(dive->getStatement(0), n, v);
-    auto right = eval(dive->getStatement(1), n, v);
+Value Emulator::evalDiveNode(const DiveNode& dive, const Env& env) {
+    auto left = eval(dive->getStatement(0), env);
+    auto right = eval(dive->getStatement(1), env);
 
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            return std::make_shared<syntax_tree::LiteralInt>("LiteralInt", left_lit->getValue() / right_lit->getValue());
-        }
+    return applyDive(left, right);
+}
+
+Value Emulator::applyDive(const Value& left, const Value& right) {
+    if (isInteger(left) && right.isFixnum() && right.fixnumValue() == -1) {
+        // x / -1 = 0 - x: так длинное целое не попадает в деление cBigNumber на -1
+        return applySub(Value::fixnum(0), left);
+    }
+    // частное двух fixnum (кроме деления на ноль - его разбирает cBigNumber) - снова
+    // целое из 64 бит: FIXNUM_MIN / -1 не переполняет int64_t
+    if (left.isFixnum() && right.isFixnum() && right.fixnumValue() != 0) {
+        return Value::integer((long long)(left.fixnumValue() / right.fixnumValue()));
+    }
+    if (isInteger(left) && isInteger(right)) {
+        return Value::integer(bigValue(left) / bigValue(right));
     }
     throw std::runtime_error("Dive operation requires integer operands");
 }
 
-LiteralInt Emulator::evalRemNode(RemNode rem, Matrix& n, Matrix& v) {
-    auto left = eval(rem->getStatement(0), n, v);
-    auto right = eval(rem->getStatement(1), n, v);
+Value Emulator::evalRemNode(const RemNode& rem, const Env& env) {
+    auto left = eval(rem->getStatement(0), env);
+    auto right = eval(rem->getStatement(1), env);
 
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            return std::make_shared<syntax_tree::LiteralInt>("LiteralInt", left_lit->getValue() % right_lit->getValue());
-        }
+    return applyRem(left, right);
+}
+
+Value Emulator::applyRem(const Value& left, const Value& right) {
+    if (isInteger(left) && right.isFixnum() && right.fixnumValue() == -1) {
+        return Value::fixnum(0);
+    }
+    if (left.isFixnum() && right.isFixnum() && right.fixnumValue() != 0) {
+        return Value::fixnum(left.fixnumValue() % right.fixnumValue());
+    }
+    if (isInteger(left) && isInteger(right)) {
+        return Value::integer(bigValue(left) % bigValue(right));
     }
     throw std::runtime_error("Rem operation requires integer operands");
 }
 
-LiteralBool Emulator::evalLeNode(LeNode le, Matrix& n, Matrix& v) {
-    auto left = eval(le->getStatement(0), n, v);
-    auto right = eval(le->getStatement(1), n, v);
+Value Emulator::evalLeNode(const LeNode& le, const Env& env) {
+    auto left = eval(le->getStatement(0), env);
+    auto right = eval(le->getStatement(1), env);
 
-    if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-        if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-            if (left_lit->getValue() <= right_lit->getValue()) {
-                return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true);
-            }
-            else {
-                return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false);
-            }
-        }
+    return applyLe(left, right);
+}
+
+Value Emulator::applyLe(const Value& left, const Value& right) {
+    if (left.isFixnum() && right.isFixnum()) {
+        return Value::boolean(left.fixnumValue() <= right.fixnumValue());
+    }
+    if (isInteger(left) && isInteger(right)) {
+        return Value::boolean(bigValue(left) <= bigValue(right));
     }
     throw std::runtime_error("Le operation requires integer operands");
 }
 
-ListNode Emulator::evalConsNode(ConsNode cons, Matrix& n, Matrix& v) {
-    auto left = eval(cons->getStatement(0), n, v);
-    auto right = eval(cons->getStatement(1), n, v);
+Value Emulator::evalConsNode(const ConsNode& cons, const Env& env) {
+    auto left = eval(cons->getStatement(0), env);
+    auto right = eval(cons->getStatement(1), env);
 
-    auto new_cons = std::make_shared<syntax_tree::ListNode>("LIST");
-    new_cons->addStatement(left);
-    if (auto cons = std::dynamic_pointer_cast<syntax_tree::ListNode>(right)) {
-        new_cons->addStatements(cons->getStatements());
-        return new_cons;
+    return applyCons(left, right);
+}
+
+Value Emulator::applyCons(const Value& left, Value right) {
+    if (right.getKind() == syntax_tree::NodeKind::List) {
+        right = listToPairs(right.toNode());
     }
-    else if (auto nil = std::dynamic_pointer_cast<syntax_tree::LiteralNil>(right)) {
-        return new_cons;
+    if (right.isNil() || (right.isNode() && right.node()->getKind() == syntax_tree::NodeKind::Pair)) {
+        // хвост не копируется, а разделяется
+        return Value::box(makeRef<syntax_tree::PairNode>(left, right));
     }
-    
+
     throw std::runtime_error("Cons error: second param must be List or Nil");
 }
 
-LiteralBool Emulator::evalEqualNode(EqualNode equal, Matrix& n, Matrix& v) {
-    auto left = eval(equal->getStatement(0), n, v);
-    auto right = eval(equal->getStatement(1), n, v);
+Value Emulator::evalEqualNode(const EqualNode& equal, const Env& env) {
+    auto left = eval(equal->getStatement(0), env);
+    auto right = eval(equal->getStatement(1), env);
 
-    bool left_is_atom = (std::dynamic_pointer_cast<syntax_tree::ListNode>(left) == nullptr);
-    bool right_is_atom = (std::dynamic_pointer_cast<syntax_tree::ListNode>(right) == nullptr);
+    return applyEqual(left, right);
+}
+
+Value Emulator::applyEqual(const Value& left, const Value& right) {
+    bool left_is_atom = !left.isList();
+    bool right_is_atom = !right.isList();
 
     if (left_is_atom || right_is_atom) {
-        if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(left)) {
-            if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralInt>(right)) {
-                if (left_lit->getValue() == right_lit->getValue()) {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true);
-                }
-                else {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false);
-                }
-            }
+        // числа, логические значения, NIL и символы непосредственные и нормализованы:
+        // равны, только если совпадают слова
+        if (!left.isNode() || !right.isNode()) {
+            return Value::boolean(left.same(right));
         }
-        if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::LiteralBool>(left)) {
-            if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::LiteralBool>(right)) {
-                if (left_lit->getValue() == right_lit->getValue()) {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true);
-                }
-                else {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false);
-                }
-            }
+        auto left_node = left.node();
+        auto right_node = right.node();
+        if (left_node->getKind() != right_node->getKind()) {
+            return Value::boolean(false);
         }
-        if (auto left_lit = std::dynamic_pointer_cast<syntax_tree::Identifier>(left)) {
-            if (auto right_lit = std::dynamic_pointer_cast<syntax_tree::Identifier>(right)) {
-                if (left_lit->getValue() == right_lit->getValue()) {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true);
-                }
-                else {
-                    return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false);
-                }
-            }
+        if (left_node->getKind() == syntax_tree::NodeKind::LiteralInt) {
+            return Value::boolean(bigValue(left) == bigValue(right));
         }
-        if (left->getNodeType() == right->getNodeType()) {
-            return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true);
+        // ключевые слова из quote (ADD, CAR, ...) однозначно задаются тегом,
+        // у замыкания и заготовки letrec (OMEGA) тег общий, их различает имя типа
+        if (left_node->getKind() != syntax_tree::NodeKind::FuncClosure) {
+            return Value::boolean(true);
         }
-        return std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false);
+        return Value::boolean(left_node->getNodeType() == right_node->getNodeType());
     }
 
     throw std::runtime_error("Equal operation requires 1 or 2 atom operands");
 }
 
-Node Emulator::evalCondNode(CondNode cond, Matrix& n, Matrix& v) {
-    auto expr = eval(cond->getStatement(0), n, v); 
+Value Emulator::applyUnary(syntax_tree::NodeKind kind, const Value& arg) {
+    using syntax_tree::NodeKind;
 
-    if (auto e = std::dynamic_pointer_cast<syntax_tree::LiteralBool>(expr)) {
-        if (e->getValue()) {
-            return eval(cond->getStatement(1), n, v);;
-        }
-        else {
-            return eval(cond->getStatement(2), n, v);
-        }
+    switch (kind) {
+        case NodeKind::Car:     return applyCar(arg);
+        case NodeKind::Cdr:     return applyCdr(arg);
+        case NodeKind::Atom:    return applyAtom(arg);
+        case NodeKind::Literal: return applyLiteral(arg);
+        default:                break;
+    }
+    throw std::runtime_error("Unknown unary operation");
+}
+
+Value Emulator::applyBinary(syntax_tree::NodeKind kind, const Value& left, const Value& right) {
+    using syntax_tree::NodeKind;
+
+    switch (kind) {
+        case NodeKind::Add:   return applyAdd(left, right);
+        case NodeKind::Sub:   return applySub(left, right);
+        case NodeKind::Mul:   return applyMul(left, right);
+        case NodeKind::Dive:  return applyDive(left, right);
+        case NodeKind::Rem:   return applyRem(left, right);
+        case NodeKind::Le:    return applyLe(left, right);
+        case NodeKind::Cons:  return applyCons(left, right);
+        case NodeKind::Equal: return applyEqual(left, right);
+        default:              break;
+    }
+    throw std::runtime_error("Unknown binary operation");
+}
+
+Node Emulator::evalCondNode(const CondNode& cond, Env& env) {
+    auto expr = eval(cond->getStatement(0), env);
+
+    if (expr.isTrue()) {
+        return cond->getStatement(1);
+    }
+    if (expr.isFalse()) {
+        return cond->getStatement(2);
     }
-    
+
     throw std::runtime_error("Cond error!");
 }
 
-Node Emulator::matrixToListNode(Matrix& matrix) {
-    auto matrix_list = std::make_shared<syntax_tree::ListNode>("LIST");
-    for (auto& row : matrix) {
-        for (auto& element : row) {
-            matrix_list->addStatement(element);
-        }
+Value Emulator::evalLambdaNode(const LambdaNode& lambda, const Env& env) {
+    // zam = cons((y e), (n v)): контекст не копируется, замыкание держит ссылку на кадр
+    return Value::box(makeRef<syntax_tree::FuncClosureNode>(lambda->getFunctionPart(), env));
+}
+
+Value Emulator::listToPairs(const Node& list) {
+    if (list->getKind() != syntax_tree::NodeKind::List) {
+        return Value::fromNode(list);
     }
-    return matrix_list;
-}
-
-FuncClosureNode Emulator::evalLambdaNode(LambdaNode lambda, Matrix& n, Matrix& v) {
-    int size = lambda->getStatementCount();
-    auto params = std::make_shared<syntax_tree::ListNode>("LIST");
-    for (int i = 0; i < size-1; i++) {
-        params->addStatement(lambda->getStatement(i));  
-    }  
-    auto body = lambda->getStatement(size-1);
-    
-    // (n v) = cons(n, cons(v, nil))
-    auto context_list = std::make_shared<syntax_tree::ListNode>("LIST"); // CONTEXT
-
-    context_list->addStatement(matrixToListNode(n)); 
-    context_list->addStatement(matrixToListNode(v));
-    
-    // (y e) = cons(y, cons(e, nil))
-    auto function_part = std::make_shared<syntax_tree::ListNode>("LIST"); // FUNCTION_PART
-    function_part->addStatement(params); 
-    function_part->addStatement(body);
-    
-    // zam = cons((y e), cons((n v), nil))
-    auto closure = std::make_shared<syntax_tree::FuncClosureNode>("CLOSURE");
-    closure->addStatement(function_part);   // (y e)
-    closure->addStatement(context_list);    // (n v)
-    
-    return closure;
-}
-
-Node Emulator::assoc(Identifier id, Matrix& n, Matrix& v) {
-    auto id_value = id->getValue();
-    
-    if (n.size() != v.size()) {
-        throw std::runtime_error("Assoc: names and values matrices have different sizes");
-    }
-    
-    for (size_t i = 0; i < n.size(); ++i) {
-        auto& names_row = n[i];
-        auto& values_row = v[i];
-        
+    Value result = Value::nil();
+    auto elements = list->getStatements();
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        result = Value::box(makeRef<syntax_tree::PairNode>(listToPairs(*it), result));
+    }
+    return result;
+}
+
+Value Emulator::assoc(const Identifier& id, const Env& env) {
+    auto id_value = id->getSymbol();
+
+    for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+        auto names_row = frame->names->getStatements();
+        const auto& values_row = frame->values;
+
         if (names_row.size() != values_row.size()) {
             throw std::runtime_error("Assoc: names and values row sizes mismatch");
         }
-        
+
         for (size_t j = 0; j < names_row.size(); ++j) {
-            if (auto identifier = std::dynamic_pointer_cast<syntax_tree::Identifier>(names_row[j])) {
-                if (identifier->getValue() == id_value) {
+            if (auto identifier = syntax_tree::node_cast<syntax_tree::Identifier>(names_row[j])) {
+                if (identifier->getSymbol() == id_value) {
                     return values_row[j];
                 }
             }
         }
     }
 
-    throw std::runtime_error("Assoc: variable '" + id_value + "' not found");
+    throw std::runtime_error("Assoc: variable '" + *id_value + "' not found");
 }
 
-Node Emulator::evalFuncCall(ListNode list, Matrix& n, Matrix& v) {
+Node Emulator::evalFuncCall(const ListNode& list, Env& env) {
     // (x1 ... xk)
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> evaluated_args;
+    std::vector<Value> evaluated_args;
+    evaluated_args.reserve(list->getStatementCount() - 1);
     for (int i = 1; i < list->getStatementCount(); i++) {
-        auto statement = list->getStatement(i);
-        auto evaluated_arg = eval(statement, n, v);
-        evaluated_args.push_back(evaluated_arg);
+        evaluated_args.push_back(eval(list->getStatement(i), env));
     }
 
     // e0
-    auto func_closure_node = eval(list->getStatement(0), n, v);
+    auto func_closure = eval(list->getStatement(0), env);
+
+    return enterClosure(func_closure, std::move(evaluated_args), env);
+}
 
-    if (auto closure = std::dynamic_pointer_cast<syntax_tree::FuncClosureNode>(func_closure_node)) {
-        if (closure->getStatement(0)->getStatement(0)->getStatementCount() != list->getStatementCount()-1) {
+Node Emulator::enterClosure(const Value& func_closure, std::vector<Value>&& evaluated_args, Env& env) {
+    if (func_closure.isNode() && func_closure.node()->getKind() == syntax_tree::NodeKind::FuncClosure) {
+        auto closure = static_cast<syntax_tree::FuncClosureNode*>(func_closure.node());
+        if (closure->getStatement(0)->getStatement(0)->getStatementCount() != evaluated_args.size()) {
             throw std::runtime_error("Function call: params count error");
         }
-        auto closure_arg_names = closure->getStatement(0)->getStatement(0)->getStatements();
+        auto closure_arg_names = closure->getStatement(0)->getStatement(0);
 
-        Matrix new_n = {};
-        Matrix new_v = {};
-        new_n.insert(new_n.begin(), closure_arg_names);
-        new_v.insert(new_v.begin(), evaluated_args); 
+        // параметры ищутся раньше контекста замыкания: n` = cons(y, n), v` = cons(x, v)
+        env = makeRef<Frame>(closure_arg_names, std::move(evaluated_args), closure->getEnv());
 
-        new_n.insert(new_n.begin(), closure->getStatement(1)->getStatement(0)->getStatements());
-        new_v.insert(new_v.begin(), closure->getStatement(1)->getStatement(1)->getStatements());
-        
-        return eval(closure->getStatement(0)->getStatement(1), new_n, new_v);
+        return closure->getStatement(0)->getStatement(1);
     } else {
-        func_closure_node->printRec(0, 5);
-        throw std::runtime_error("Function call: first element must be a closure");
+        std::ostringstream head;
+        func_closure.printFlat(0, head);
+        std::string text = head.str();
+        if (text.size() > 80) {
+            text = text.substr(0, 77) + "...";
+        }
+        throw std::runtime_error("Function call: first element must be a closure, got " + text);
     }
 }
 
-Node Emulator::evalLetNode(LetNode let, Matrix& n, Matrix& v) {
+Node Emulator::evalLetNode(const LetNode& let, Env& env) {
     auto expr = let->getStatement(0);
 
     // (e1 ... ek)
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> variables_values;
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> variables_names;
+    std::vector<Value> variables_values;
+    auto variables_names = makeRef<syntax_tree::ListNode>();
     for (int i = 1; i < let->getStatementCount(); i++) {
         auto statement = let->getStatement(i);
-        auto evaluated_arg = eval(statement->getStatement(1), n, v);
-        variables_names.push_back(statement->getStatement(0));
-        variables_values.push_back(evaluated_arg);
+        variables_values.push_back(eval(statement->getStatement(1), env));
+        variables_names->addStatement(statement->getStatement(0));
     }
 
-    // nv refresh
-    n.insert(n.begin(), variables_names);
-    v.insert(v.begin(), variables_values);
+    // nv refresh: связывания видны только в теле let
+    env = makeRef<Frame>(variables_names, std::move(variables_values), env);
 
-    return eval(expr, n, v);
+    return expr;
 }
 
-Node Emulator::evalLetrecNode(LetrecNode letrec, Matrix& n, Matrix& v) {
+Node Emulator::evalLetrecNode(const LetrecNode& letrec, Env& env) {
     auto expr = letrec->getStatement(0);
 
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> variables_names; 
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> variables_values;
-    for (int i = 1; i < letrec->getStatementCount(); i++) {
-        auto statement = letrec->getStatement(i);
-        variables_names.push_back(statement->getStatement(0));
-        auto evaluated_arg = std::make_shared<syntax_tree::FuncClosureNode>("OMEGA");
-        variables_values.push_back(evaluated_arg);
-    }
-    n.insert(n.begin(), variables_names); // n`
-    v.insert(v.begin(), variables_values); //v`
+    auto new_env = letrecFrame(letrec, env); // (n` v`)
 
-    //printMatrix(n, v);
+    //printEnv(new_env);
 
     //z
     // (letrec
     //     (sum (quote(1 2 3 4 -5))) (
     //         sum (
     //             lambda (a) (
-    //                     cond 
-    //                         (equal a (quote())) 
-    //                         (quote 0) 
-    //                         (add (car a) (sum (cdr a))) 
+    //                     cond
+    //                         (equal a (quote()))
+    //                         (quote 0)
+    //                         (add (car a) (sum (cdr a)))
     //             )
     //         )
     //     )
@@ -470,56 +493,66 @@ Node Emulator::evalLetrecNode(LetrecNode letrec, Matrix& n, Matrix& v) {
     // для этого примера список z будет состоять из замыкания с контекстом ((sum) (OMEGA))
     // а если бы в окружении была переменная `a` с значением 123, то замыкание = ((sum a) (OMEGA 123))
 
-    std::vector<std::shared_ptr<syntax_tree::ASTNode>> z; 
+    std::vector<Value> z;
     for (int i = 1; i < letrec->getStatementCount(); i++) {
         auto statement = letrec->getStatement(i);
-        auto evaluated_arg = eval(statement->getStatement(1), n, v);
-        z.push_back(evaluated_arg);
+        z.push_back(eval(statement->getStatement(1), new_env));
     }
-    
-    complete(v, z);
 
-    return eval(expr, n, v);
+    complete(new_env, z);
+
+    env = new_env;
+    return expr;
 }
 
-Matrix& Emulator::complete(Matrix& v, std::vector<std::shared_ptr<syntax_tree::ASTNode>>& z) {
+Env Emulator::letrecFrame(const LetrecNode& letrec, const Env& env) {
+    auto variables_names = makeRef<syntax_tree::ListNode>();
+    std::vector<Value> variables_values;
+    for (size_t i = 1; i < letrec->getStatementCount(); i++) {
+        auto statement = letrec->getStatement(i);
+        variables_names->addStatement(statement->getStatement(0));
+        variables_values.push_back(Value::box(makeRef<syntax_tree::FuncClosureNode>()));
+    }
+    return makeRef<Frame>(variables_names, std::move(variables_values), env);
+}
+
+void Emulator::complete(const Env& env, const std::vector<Value>& z) {
+    auto& values = env->values;
     for (size_t i = 0; i < z.size(); i++) {
-        if (typeid(*v[0][i]) != typeid(*z[i])) {
+        if (values[i].getKind() != z[i].getKind()) {
             throw std::runtime_error("Letrec: local definitions can only be closures.");
         }
-        *v[0][i] = *z[i];
+        values[i] = z[i];
     }
-    return v;
+    // кадр замкнут в цикл через свои замыкания: счёт ссылок его уже не освободит
+    Collector::safepoint();
 }
 
-Node Emulator::evalClosure(FuncClosureNode closure, Matrix& n, Matrix& v) {
-    Matrix local_n = {closure->getStatement(1)->getStatement(0)->getStatements()};
-    Matrix local_v = {closure->getStatement(1)->getStatement(1)->getStatements()};
-
-    return eval(closure->getStatement(0)->getStatement(1), n, v);
+Value Emulator::evalClosure(const FuncClosureNode& closure, const Env& env) {
+    return eval(closure->getStatement(0)->getStatement(1), env);
 }
 
-void Emulator::printMatrixFlat(Matrix& n, Matrix& v) {
+void Emulator::printEnvFlat(const Env& env) {
     std::cout << "[";
-    for (size_t i = 0; i < n.size(); ++i) {
-        auto& names_row = n[i];
-        auto& values_row = v[i];
+    for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+        auto names_row = frame->names->getStatements();
+        const auto& values_row = frame->values;
         std::cout << "\n\t{";
         for (size_t j = 0; j < names_row.size(); ++j) {
             std::cout << "\n\t\t";
             names_row[j]->printFlat();
             std::cout << " = ";
-            values_row[j]->printFlat();
+            values_row[j].printFlat();
         }
         std::cout << "\n\t}";
     }
     std::cout << "\n]\n";
 }
 
-void Emulator::printMatrix(Matrix& n, Matrix& v) {
+void Emulator::printEnv(const Env& env) {
     std::cout << "\n\n((------------------------\nn=[";
-    for (size_t i = 0; i < n.size(); ++i) {
-        auto& names_row = n[i];
+    for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+        auto names_row = frame->names->getStatements();
         std::cout << "\n\t{";
         for (size_t j = 0; j < names_row.size(); ++j) {
             std::cout << "\n";
@@ -528,14 +561,14 @@ void Emulator::printMatrix(Matrix& n, Matrix& v) {
         std::cout << "\n\t}";
     }
     std::cout << "\n] \nv=[";
-    for (size_t i = 0; i < v.size(); ++i) {
-        auto& values_row = v[i];
+    for (Frame* frame = env.get(); frame; frame = frame->parent.get()) {
+        const auto& values_row = frame->values;
         std::cout << "\n\t{";
         for (size_t j = 0; j < values_row.size(); ++j) {
             std::cout << "\n";
-            values_row[j]->print(5);
+            values_row[j].print(5);
         }
         std::cout << "\n\t}";
     }
     std::cout << "\n))------------------------\n\n";
-}
\ No newline at end of file
+}
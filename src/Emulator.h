@@ -2,76 +2,100 @@
 
 #include <vector>
 #include "AST.h"
+#include "Environment.h"
 
-typedef std::vector<std::vector<std::shared_ptr<syntax_tree::ASTNode>>> Matrix;
-typedef std::shared_ptr<syntax_tree::ASTNode> Node;
-typedef std::shared_ptr<syntax_tree::ListNode> ListNode;
-typedef std::shared_ptr<syntax_tree::LiteralInt> LiteralInt;
-typedef std::shared_ptr<syntax_tree::LiteralNil> LiteralNil;
-typedef std::shared_ptr<syntax_tree::LiteralBool> LiteralBool;
-typedef std::shared_ptr<syntax_tree::Identifier> Identifier;
-typedef std::shared_ptr<syntax_tree::QuoteNode> QuoteNode;
-typedef std::shared_ptr<syntax_tree::CarNode> CarNode;
-typedef std::shared_ptr<syntax_tree::CdrNode> CdrNode;
-typedef std::shared_ptr<syntax_tree::AtomNode> AtomNode;
-typedef std::shared_ptr<syntax_tree::LiteralNode> LiteralNode;
-typedef std::shared_ptr<syntax_tree::AddNode> AddNode;
-typedef std::shared_ptr<syntax_tree::SubNode> SubNode;
-typedef std::shared_ptr<syntax_tree::MulNode> MulNode;
-typedef std::shared_ptr<syntax_tree::DiveNode> DiveNode;
-typedef std::shared_ptr<syntax_tree::RemNode> RemNode;
-typedef std::shared_ptr<syntax_tree::LeNode> LeNode;
-typedef std::shared_ptr<syntax_tree::ConsNode> ConsNode;
-typedef std::shared_ptr<syntax_tree::EqualNode> EqualNode;
-typedef std::shared_ptr<syntax_tree::CondNode> CondNode;
-typedef std::shared_ptr<syntax_tree::LambdaNode> LambdaNode;
-typedef std::shared_ptr<syntax_tree::FuncClosureNode> FuncClosureNode;
-typedef std::shared_ptr<syntax_tree::LetNode> LetNode;
-typedef std::shared_ptr<syntax_tree::LetrecNode> LetrecNode;
+typedef Ref<syntax_tree::ASTNode> Node;
+typedef Ref<syntax_tree::ListNode> ListNode;
+typedef Ref<syntax_tree::PairNode> PairNode;
+typedef Ref<syntax_tree::LiteralInt> LiteralInt;
+typedef Ref<syntax_tree::LiteralNil> LiteralNil;
+typedef Ref<syntax_tree::LiteralBool> LiteralBool;
+typedef Ref<syntax_tree::Identifier> Identifier;
+typedef Ref<syntax_tree::QuoteNode> QuoteNode;
+typedef Ref<syntax_tree::CarNode> CarNode;
+typedef Ref<syntax_tree::CdrNode> CdrNode;
+typedef Ref<syntax_tree::AtomNode> AtomNode;
+typedef Ref<syntax_tree::LiteralNode> LiteralNode;
+typedef Ref<syntax_tree::AddNode> AddNode;
+typedef Ref<syntax_tree::SubNode> SubNode;
+typedef Ref<syntax_tree::MulNode> MulNode;
+typedef Ref<syntax_tree::DiveNode> DiveNode;
+typedef Ref<syntax_tree::RemNode> RemNode;
+typedef Ref<syntax_tree::LeNode> LeNode;
+typedef Ref<syntax_tree::ConsNode> ConsNode;
+typedef Ref<syntax_tree::EqualNode> EqualNode;
+typedef Ref<syntax_tree::CondNode> CondNode;
+typedef Ref<syntax_tree::LambdaNode> LambdaNode;
+typedef Ref<syntax_tree::FuncClosureNode> FuncClosureNode;
+typedef Ref<syntax_tree::LetNode> LetNode;
+typedef Ref<syntax_tree::LetrecNode> LetrecNode;
+typedef syntax_tree::Value Value;
 
+// Вычислитель над AST. Узлы программы - Node, результаты вычисления - Value: числа,
+// логические значения, NIL и символы в нём непосредственные, в куче только пары,
+// замыкания и длинные числа.
 class Emulator {
-private:
-    Node eval(Node e, Matrix& n, Matrix& v);
+protected:
+    Value eval(Node e, Env env);
 
-    LiteralInt evalLiteralInt(LiteralInt litInt, Matrix& n, Matrix& v);
-    LiteralNil evalLiteralNil(LiteralNil litNil, Matrix& n, Matrix& v);
-    LiteralBool evalLiteralBool(LiteralBool litBool, Matrix& n, Matrix& v);
-    Node evalIdentifier(Identifier id, Matrix& n, Matrix& v);
+    Value evalIdentifier(const Identifier& id, const Env& env);
 
     // unary
-    Node evalQuoteNode(QuoteNode quote, Matrix& n, Matrix& v);
-    Node evalCarNode(CarNode car, Matrix& n, Matrix& v);
-    Node evalCdrNode(CdrNode cdr, Matrix& n, Matrix& v);
-    Node evalAtomNode(AtomNode atom, Matrix& n, Matrix& v);
-    Node evalLiteralNode(LiteralNode literal, Matrix& n, Matrix& v);
+    Value evalQuoteNode(const QuoteNode& quote);
+    Value evalCarNode(const CarNode& car, const Env& env);
+    Value evalCdrNode(const CdrNode& cdr, const Env& env);
+    Value evalAtomNode(const AtomNode& atom, const Env& env);
+    Value evalLiteralNode(const LiteralNode& literal, const Env& env);
 
     // binary
-    LiteralInt evalAddNode(AddNode add, Matrix& n, Matrix& v);
-    LiteralInt evalSubNode(SubNode sub, Matrix& n, Matrix& v);
-    LiteralInt evalMulNode(MulNode mul, Matrix& n, Matrix& v);
-    LiteralInt evalDiveNode(DiveNode dive, Matrix& n, Matrix& v);
-    LiteralInt evalRemNode(RemNode rem, Matrix& n, Matrix& v);
-    LiteralBool evalLeNode(LeNode le, Matrix& n, Matrix& v);
-    ListNode evalConsNode(ConsNode cons, Matrix& n, Matrix& v);
-    LiteralBool evalEqualNode(EqualNode equal, Matrix& n, Matrix& v);
+    Value evalAddNode(const AddNode& add, const Env& env);
+    Value evalSubNode(const SubNode& sub, const Env& env);
+    Value evalMulNode(const MulNode& mul, const Env& env);
+    Value evalDiveNode(const DiveNode& dive, const Env& env);
+    Value evalRemNode(const RemNode& rem, const Env& env);
+    Value evalLeNode(const LeNode& le, const Env& env);
+    Value evalConsNode(const ConsNode& cons, const Env& env);
+    Value evalEqualNode(const EqualNode& equal, const Env& env);
+
+    // примитивы над уже вычисленными аргументами
+    Value applyCar(Value c);
+    Value applyCdr(Value c);
+    Value applyAtom(const Value& arg);
+    Value applyLiteral(const Value& arg);
+    Value applyAdd(const Value& left, const Value& right);
+    Value applySub(const Value& left, const Value& right);
+    Value applyMul(const Value& left, const Value& right);
+    Value applyDive(const Value& left, const Value& right);
+    Value applyRem(const Value& left, const Value& right);
+    Value applyLe(const Value& left, const Value& right);
+    Value applyCons(const Value& left, Value right);
+    Value applyEqual(const Value& left, const Value& right);
+    static bool isInteger(const Value& v);
+    static cBigNumber bigValue(const Value& v);
+    Value applyUnary(syntax_tree::NodeKind kind, const Value& arg);
+    Value applyBinary(syntax_tree::NodeKind kind, const Value& left, const Value& right);
 
     // ternary
-    Node evalCondNode(CondNode cond, Matrix& n, Matrix& v);
+    // хвостовые формы возвращают выражение в хвостовой позиции и его окружение в env
+    Node evalCondNode(const CondNode& cond, Env& env);
 
     //other
-    FuncClosureNode evalLambdaNode(LambdaNode lambda, Matrix& n, Matrix& v);
-    Node evalFuncCall(ListNode list, Matrix& n, Matrix& v);
-    Node evalLetNode(LetNode let, Matrix& n, Matrix& v);
-    Node evalLetrecNode(LetrecNode letrec, Matrix& n, Matrix& v);
-    Node evalClosure(FuncClosureNode closure, Matrix& n, Matrix& v);
+    Value evalLambdaNode(const LambdaNode& lambda, const Env& env);
+    Node evalFuncCall(const ListNode& list, Env& env);
+    Node enterClosure(const Value& func_closure, std::vector<Value>&& evaluated_args, Env& env);
+    Node evalLetNode(const LetNode& let, Env& env);
+    Node evalLetrecNode(const LetrecNode& letrec, Env& env);
+    Value evalClosure(const FuncClosureNode& closure, const Env& env);
 
     //auxiliary functions
-    Node matrixToListNode(Matrix& matrix);
-    Node assoc(Identifier id, Matrix& n, Matrix& v);
-    Matrix& complete(Matrix& v, std::vector<std::shared_ptr<syntax_tree::ASTNode>>& z);
-    void printMatrixFlat(Matrix& n, Matrix& v);
-    void printMatrix(Matrix& n, Matrix& v);
+    Value listToPairs(const Node& list);
+    Value assoc(const Identifier& id, const Env& env);
+    Env letrecFrame(const LetrecNode& letrec, const Env& env);
+    void complete(const Env& env, const std::vector<Value>& z);
+    void printEnvFlat(const Env& env);
+    void printEnv(const Env& env);
 
 public:
-    syntax_tree::AST eval(syntax_tree::AST ast);
-};
\ No newline at end of file
+    virtual ~Emulator() = default;
+    virtual syntax_tree::AST eval(syntax_tree::AST ast);
+};
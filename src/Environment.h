@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Ref.h"
+#include "Value.h"
+
+// Кадр окружения: имена и значения одного уровня (параметры вызова или связывания
+// let/letrec) и ссылка на объемлющий кадр. Кадры разделяются по ссылке, поэтому
+// вызов создаёт ровно один новый кадр и никогда не копирует внешние. Ячейка значения -
+// одно слово (Value).
+// Все живые кадры связаны в список: по нему Collector ищет циклы, которые создаёт letrec.
+struct Frame {
+    Ref<syntax_tree::ASTNode> names;  // список идентификаторов
+    std::vector<syntax_tree::Value> values; // значения той же длины
+    Ref<Frame> parent;
+    uint32_t refs = 0;
+    uint32_t gc_refs = 0; // рабочее поле Collector
+    Frame* prev = nullptr;
+    Frame* next = nullptr;
+
+    inline static Frame* all = nullptr;
+    inline static size_t live = 0;
+
+    Frame(Ref<syntax_tree::ASTNode> n, std::vector<syntax_tree::Value> v, Ref<Frame> p)
+        : names(std::move(n)), values(std::move(v)), parent(std::move(p)), next(all) {
+        if (all) all->prev = this;
+        all = this;
+        live++;
+    }
+    ~Frame() {
+        if (prev) prev->next = next;
+        else all = next;
+        if (next) next->prev = prev;
+        live--;
+    }
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+};
+
+inline void refRetain(Frame* frame) { frame->refs++; }
+inline void refRelease(Frame* frame) {
+    if (--frame->refs == 0) delete frame;
+}
+
+typedef Ref<Frame> Env;
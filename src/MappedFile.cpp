@@ -0,0 +1,68 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+
+MappedFile::MappedFile(const std::string& filename) {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    length = static_cast<size_t>(file_size.QuadPart);
+    if (length == 0) {
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!bytes) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map file: " + filename);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file: " + filename);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map file: " + filename);
+        }
+        bytes = static_cast<const char*>(p);
+    }
+    // отображение остаётся действительным и после закрытия дескриптора
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+#endif
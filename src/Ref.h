@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// Владеющая ссылка со счётчиком внутри объекта (узла AST, кадра окружения, арены).
+// Вычисление однопоточное, поэтому счётчик - обычное целое, а не атомарное, как
+// у std::shared_ptr, и отдельного блока управления нет. Объект типа T задаёт счёт
+// свободными функциями refRetain(T*) и refRelease(T*), которые находятся по ADL;
+// refRelease уничтожает объект, когда счётчик доходит до нуля.
+template <class T>
+class Ref {
+private:
+    T* ptr = nullptr;
+
+    template <class U>
+    friend class Ref;
+
+public:
+    typedef T element_type;
+
+    Ref() {}
+    Ref(std::nullptr_t) {}
+    explicit Ref(T* p) : ptr(p) {
+        if (ptr) refRetain(ptr);
+    }
+    Ref(const Ref& other) : ptr(other.ptr) {
+        if (ptr) refRetain(ptr);
+    }
+    Ref(Ref&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+    template <class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Ref(const Ref<U>& other) : ptr(other.ptr) {
+        if (ptr) refRetain(ptr);
+    }
+    template <class U, class = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Ref(Ref<U>&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+    ~Ref() {
+        if (ptr) refRelease(ptr);
+    }
+
+    // по значению: присваивание самому себе и из Ref<U> обрабатываются одинаково
+    Ref& operator=(Ref other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    void reset() { Ref().swap(*this); }
+    void swap(Ref& other) noexcept { std::swap(ptr, other.ptr); }
+    unsigned use_count() const { return ptr ? refCount(ptr) : 0; }
+};
+
+template <class T, class U>
+bool operator==(const Ref<T>& a, const Ref<U>& b) { return a.get() == b.get(); }
+template <class T, class U>
+bool operator!=(const Ref<T>& a, const Ref<U>& b) { return a.get() != b.get(); }
+template <class T>
+bool operator==(const Ref<T>& a, std::nullptr_t) { return !a; }
+template <class T>
+bool operator!=(const Ref<T>& a, std::nullptr_t) { return static_cast<bool>(a); }
+template <class T>
+bool operator==(std::nullptr_t, const Ref<T>& a) { return !a; }
+template <class T>
+bool operator!=(std::nullptr_t, const Ref<T>& a) { return static_cast<bool>(a); }
+
+template <class T, class... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+// приведение к подклассу без проверки, как std::static_pointer_cast
+template <class T, class U>
+Ref<T> refCast(const Ref<U>& ref) {
+    return Ref<T>(static_cast<T*>(ref.get()));
+}
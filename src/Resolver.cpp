@@ -0,0 +1,80 @@
+#include "Resolver.h"
+
+void Resolver::resolve(syntax_tree::AST& ast) {
+    if (ast.isEmpty()) {
+        return;
+    }
+    Scope scope;
+    resolve(ast.getRoot(), scope);
+}
+
+void Resolver::resolve(const Ref<syntax_tree::ASTNode>& e, Scope& scope) {
+    using syntax_tree::NodeKind;
+
+    switch (e->getKind()) {
+        case NodeKind::Identifier:
+            resolveIdentifier(refCast<syntax_tree::Identifier>(e), scope);
+            return;
+        case NodeKind::Quote:
+            // данные не вычисляются
+            return;
+        case NodeKind::Lambda:
+            resolveLambda(refCast<syntax_tree::LambdaNode>(e), scope);
+            return;
+        case NodeKind::Let:
+            resolveLet(e, scope, false);
+            return;
+        case NodeKind::Letrec:
+            resolveLet(e, scope, true);
+            return;
+        default:
+            for (auto& stmt : e->getStatements()) {
+                resolve(stmt, scope);
+            }
+            return;
+    }
+}
+
+void Resolver::resolveIdentifier(const Ref<syntax_tree::Identifier>& id, Scope& scope) {
+    auto name = id->getSymbol();
+    for (size_t i = 0; i < scope.size(); ++i) {
+        for (size_t j = 0; j < scope[i].size(); ++j) {
+            if (scope[i][j] == name) {
+                id->setLocation(i, j);
+                return;
+            }
+        }
+    }
+    // свободная переменная: остаётся поиску по имени, который сообщит об ошибке
+}
+
+void Resolver::resolveLambda(const Ref<syntax_tree::LambdaNode>& lambda, Scope& scope) {
+    int size = lambda->getStatementCount();
+
+    // тело вычисляется в окружении cons(y, n): кадр параметров над кадрами замыкания
+    std::vector<syntax_tree::Symbol> params;
+    for (int i = 0; i < size-1; i++) {
+        params.push_back(refCast<syntax_tree::Identifier>(lambda->getStatement(i))->getSymbol());
+    }
+
+    Scope body_scope = scope;
+    body_scope.insert(body_scope.begin(), params);
+    resolve(lambda->getStatement(size-1), body_scope);
+}
+
+void Resolver::resolveLet(const Ref<syntax_tree::ASTNode>& let, Scope& scope, bool recursive) {
+    std::vector<syntax_tree::Symbol> names;
+    for (size_t i = 1; i < let->getStatementCount(); i++) {
+        auto name = let->getStatement(i)->getStatement(0);
+        names.push_back(refCast<syntax_tree::Identifier>(name)->getSymbol());
+    }
+
+    Scope inner_scope = scope;
+    inner_scope.insert(inner_scope.begin(), names);
+
+    // для let выражения связываний вычисляются во внешнем окружении
+    for (size_t i = 1; i < let->getStatementCount(); i++) {
+        resolve(let->getStatement(i)->getStatement(1), recursive ? inner_scope : scope);
+    }
+    resolve(let->getStatement(0), inner_scope);
+}
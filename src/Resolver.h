@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "AST.h"
+
+// Проход лексической адресации: заменяет поиск переменной по имени (Emulator::assoc)
+// на пару (номер кадра, номер ячейки), как это делает LOCATION в compiler.lisp.
+// Статическая область видимости повторяет цепочку кадров окружения эмулятора.
+class Resolver {
+private:
+    typedef std::vector<std::vector<syntax_tree::Symbol>> Scope;
+
+    void resolve(const Ref<syntax_tree::ASTNode>& e, Scope& scope);
+    void resolveIdentifier(const Ref<syntax_tree::Identifier>& id, Scope& scope);
+    void resolveLambda(const Ref<syntax_tree::LambdaNode>& lambda, Scope& scope);
+    void resolveLet(const Ref<syntax_tree::ASTNode>& let, Scope& scope, bool recursive);
+
+public:
+    void resolve(syntax_tree::AST& ast);
+};
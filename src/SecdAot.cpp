@@ -0,0 +1,232 @@
+#include "SecdAot.h"
+#include <fstream>
+#include <sstream>
+
+void SecdAot::translate(const SecdVM& vm, const std::string& filename) {
+    if (!vm.code) {
+        throw std::runtime_error("Secd: no program loaded");
+    }
+    dynamic.clear();
+    local.clear();
+    collectLabels(vm);
+
+    std::ofstream out(filename, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    out << "// Программа SECD, переведённая в C++ (main --secd ... --emit-cpp).\n";
+    out << "// Сборка: g++ -std=c++17 -O2 -Isrc <этот файл> src/SecdNative.cpp src/SecdVM.cpp src/SecdJit.cpp\n";
+    out << "//         src/SecdReader.cpp src/MappedFile.cpp src/cBigNumber/*.cpp\n";
+    out << "#include \"SecdNative.h\"\n\n";
+    writeTables(vm, out);
+
+    out << "SecdNative::Value SecdNative::run(uint32_t pc) {\n";
+    out << "    for (;;) {\n";
+    out << "    switch (pc) {\n";
+    for (uint32_t pc = 0; pc < vm.code_count; pc++) {
+        if (dynamic.count(pc)) {
+            out << "    case " << pc << ":\n";
+        }
+        if (local.count(pc)) {
+            out << "    L_" << pc << ":\n";
+        }
+        out << "        { ";
+        writeInstruction(vm, pc, out);
+        out << " }\n";
+    }
+    out << "    default:\n";
+    out << "        throw std::runtime_error(\"Secd: bad jump\");\n";
+    out << "    }\n";
+    out << "    }\n";
+    out << "}\n\n";
+
+    out << "int main(int argc, char* argv[]) {\n";
+    out << "    return SecdNative::main(argc, argv, image);\n";
+    out << "}\n";
+    if (!out) {
+        throw std::runtime_error("Cannot write file: " + filename);
+    }
+}
+
+void SecdAot::collectLabels(const SecdVM& vm) {
+    typedef SecdVM::Op Op;
+
+    dynamic.insert(vm.entry);
+    dynamic.insert(vm.apply);
+    // замыкания из констант и из образа вычисленной программы
+    auto closure = [&](SecdVM::Value v) {
+        if (SecdVM::isClosure(v)) {
+            dynamic.insert(SecdVM::fixnumValue(vm.heap[v >> 3].car));
+        }
+    };
+    closure(vm.resident);
+    for (uint32_t i = 0; i < vm.constant_count; i++) {
+        closure(vm.constants[i]);
+    }
+    for (const auto& cell : vm.heap) {
+        closure(cell.car);
+        closure(cell.cdr);
+    }
+    for (uint32_t pc = 0; pc < vm.code_count; pc++) {
+        const SecdVM::Instr& instr = vm.code[pc];
+        switch (instr.op) {
+            case Op::LDF:
+                dynamic.insert(instr.a);
+                break;
+            case Op::AP:
+            case Op::RAP:
+            case Op::LDAP:
+                dynamic.insert(pc + 1);
+                break;
+            case Op::SEL:
+                dynamic.insert(pc + 1);
+                local.insert(instr.a);
+                local.insert(instr.b);
+                break;
+            case Op::TSEL:
+                local.insert(instr.a);
+                local.insert(instr.b);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void SecdAot::writeTables(const SecdVM& vm, std::ostream& out) {
+    // пустой массив в C++ запрещён, вместо него в образ пишется nullptr
+    auto array = [&](const char* type, const char* name, const std::vector<std::string>& items) {
+        if (items.empty()) {
+            return;
+        }
+        out << "static const " << type << " " << name << "[] = {\n";
+        for (size_t i = 0; i < items.size(); i++) {
+            out << "    " << items[i] << ",\n";
+        }
+        out << "};\n\n";
+    };
+    auto pointer = [](const char* name, size_t count) {
+        return count > 0 ? std::string(name) : std::string("nullptr");
+    };
+
+    std::vector<std::string> symbols;
+    for (auto name : vm.symbols) {
+        symbols.push_back(quote(*name));
+    }
+    std::vector<std::string> bignums;
+    for (const auto& n : vm.bignums) {
+        std::ostringstream text;
+        text << n;
+        bignums.push_back(quote(text.str()));
+    }
+    std::vector<std::string> cells;
+    for (const auto& cell : vm.heap) {
+        cells.push_back(std::to_string(cell.car) + "u, " + std::to_string(cell.cdr) + "u");
+    }
+    std::vector<std::string> constants;
+    for (uint32_t i = 0; i < vm.constant_count; i++) {
+        constants.push_back(std::to_string(vm.constants[i]) + "u");
+    }
+    array("char* const", "symbols", symbols);
+    array("char* const", "bignums", bignums);
+    array("uint64_t", "cells", cells);
+    array("SecdNative::Value", "constants", constants);
+
+    out << "static const SecdNative::Image image = {\n";
+    out << "    " << vm.entry << ", " << vm.apply << ", " << vm.resident << "u,\n";
+    out << "    " << pointer("symbols", symbols.size()) << ", " << symbols.size() << ",\n";
+    out << "    " << pointer("bignums", bignums.size()) << ", " << bignums.size() << ",\n";
+    out << "    " << pointer("cells", cells.size()) << ", " << cells.size() << ",\n";
+    out << "    " << pointer("constants", constants.size()) << ", " << constants.size() << "\n";
+    out << "};\n\n";
+}
+
+void SecdAot::writeInstruction(const SecdVM& vm, uint32_t pc, std::ostream& out) {
+    static const char* names[] = {
+        "LD", "LDC", "LDF", "AP", "RTN", "SEL", "JOIN", "DUM", "RAP", "STOP",
+        "CAR", "CDR", "ATOM", "LITERAL", "CONS", "ADD", "SUB", "MUL", "DIVE", "REM", "LE", "EQUAL",
+        "TAP", "TRAP", "TSEL", "LDAP", "LDTAP", "FRAME"
+    };
+    typedef SecdVM::Op Op;
+
+    const SecdVM::Instr& instr = vm.code[pc];
+    uint32_t next = pc + 1;
+    switch (instr.op) {
+        case Op::LD:
+            out << "push(ld(" << instr.a << ", " << instr.b << "));";
+            break;
+        case Op::LDC:
+            out << "push(constants[" << instr.a << "]);";
+            break;
+        case Op::LDF:
+            out << "push(vm.closure(" << instr.a << ", vm.env));";
+            break;
+        case Op::AP:
+            out << "Value f = pop(); pc = call(f, " << next << "); continue;";
+            break;
+        case Op::TAP:
+            out << "Value f = pop(); pc = call(f, NO_RETURN); continue;";
+            break;
+        case Op::LDAP:
+            out << "pc = call(ld(" << instr.a << ", " << instr.b << "), " << next << "); continue;";
+            break;
+        case Op::LDTAP:
+            out << "pc = call(ld(" << instr.a << ", " << instr.b << "), NO_RETURN); continue;";
+            break;
+        case Op::RAP:
+            out << "pc = recursiveCall(" << next << "); continue;";
+            break;
+        case Op::TRAP:
+            out << "pc = recursiveCall(NO_RETURN); continue;";
+            break;
+        case Op::RTN:
+            out << "pc = rtn(); continue;";
+            break;
+        case Op::JOIN:
+            out << "pc = join(); continue;";
+            break;
+        case Op::SEL:
+            out << "if (select(" << next << ")) goto L_" << instr.a << "; goto L_" << instr.b << ";";
+            break;
+        case Op::TSEL:
+            out << "if (select(NO_RETURN)) goto L_" << instr.a << "; goto L_" << instr.b << ";";
+            break;
+        case Op::DUM:
+            out << "dum();";
+            break;
+        case Op::STOP:
+            out << "return stop();";
+            break;
+        case Op::CAR:
+        case Op::CDR:
+        case Op::ATOM:
+        case Op::LITERAL:
+            out << "unary(Op::" << names[static_cast<int>(instr.op)] << ");";
+            break;
+        case Op::FRAME:
+            out << "frame(" << instr.a << ");";
+            break;
+        default:
+            out << "binary(Op::" << names[static_cast<int>(instr.op)] << ");";
+            break;
+    }
+}
+
+std::string SecdAot::quote(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (c < 32 || c >= 127) {
+            // восьмеричная запись не поглощает следующие цифры, в отличие от \x
+            out << '\\' << char('0' + (c >> 6)) << char('0' + ((c >> 3) & 7)) << char('0' + (c & 7));
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <ostream>
+#include <set>
+#include <string>
+#include "SecdVM.h"
+
+// Перевод загруженной программы SECD в единицу трансляции C++ (см. SecdNative.h).
+// Каждая инструкция становится вызовом шага SecdNative, ветви SEL - переходами goto,
+// а адреса, которые становятся известны только при выполнении (тела LDF, точки возврата
+// после вызовов и SEL), - метками case общего switch. Таблицы констант, ячеек, символов
+// и длинных чисел записываются в тот же файл, поэтому программа не читает код при запуске.
+class SecdAot {
+private:
+    std::set<uint32_t> dynamic; // метки case
+    std::set<uint32_t> local;   // метки goto
+
+    void collectLabels(const SecdVM& vm);
+    void writeTables(const SecdVM& vm, std::ostream& out);
+    void writeInstruction(const SecdVM& vm, uint32_t pc, std::ostream& out);
+    static std::string quote(const std::string& text);
+
+public:
+    void translate(const SecdVM& vm, const std::string& filename);
+};
@@ -0,0 +1,170 @@
+#include "SecdCompiler.h"
+
+syntax_tree::AST SecdCompiler::compile(syntax_tree::AST& program) {
+    if (program.isEmpty()) {
+        throw std::runtime_error("Compile: program is empty");
+    }
+    // COMPILE: (COMP E (QUOTE NIL) (QUOTE (STOP)))
+    auto c = makeRef<syntax_tree::ListNode>();
+    comp(program.getRoot(), nullptr, c);
+    emit(c, "STOP");
+    return syntax_tree::AST(c);
+}
+
+void SecdCompiler::emit(Code& c, const std::string& instr) {
+    c->addStatement(makeRef<syntax_tree::Identifier>(instr));
+}
+
+// код выражения дописывается в конец c: COMP строит список с конца, здесь он растёт с начала
+void SecdCompiler::comp(const Node& e, const Names* n, Code& c) {
+    using syntax_tree::NodeKind;
+
+    switch (e->getKind()) {
+        case NodeKind::LiteralInt:
+        case NodeKind::LiteralBool:
+        case NodeKind::LiteralNil:
+            emit(c, "LDC");
+            c->addStatement(e);
+            return;
+        case NodeKind::Identifier:
+            emit(c, "LD");
+            c->addStatement(location(refCast<syntax_tree::Identifier>(e), n));
+            return;
+        case NodeKind::Quote:
+            if (e->getStatementCount() != 1) {
+                break;
+            }
+            emit(c, "LDC");
+            c->addStatement(e->getStatement(0));
+            return;
+        case NodeKind::Car:
+        case NodeKind::Cdr:
+        case NodeKind::Atom:
+        case NodeKind::Literal:
+            // LITERAL в compiler.lisp не компилируется, но SecdVM его выполняет
+            if (e->getStatementCount() != 1) {
+                break;
+            }
+            comp(e->getStatement(0), n, c);
+            emit(c, e->getNodeType());
+            return;
+        case NodeKind::Add:
+        case NodeKind::Sub:
+        case NodeKind::Mul:
+        case NodeKind::Dive:
+        case NodeKind::Rem:
+        case NodeKind::Le:
+        case NodeKind::Equal:
+        case NodeKind::Cons:
+            if (e->getStatementCount() != 2) {
+                break;
+            }
+            compBinary(e, n, c);
+            return;
+        case NodeKind::Cond: {
+            if (e->getStatementCount() != 3) {
+                break;
+            }
+            comp(e->getStatement(0), n, c);
+            emit(c, "SEL");
+            for (size_t i = 1; i <= 2; i++) {
+                auto branch = makeRef<syntax_tree::ListNode>();
+                comp(e->getStatement(i), n, branch);
+                emit(branch, "JOIN");
+                c->addStatement(branch);
+            }
+            return;
+        }
+        case NodeKind::Lambda: {
+            if (e->getStatementCount() == 0) {
+                break;
+            }
+            size_t size = e->getStatementCount();
+            Names m{{}, n};
+            for (size_t i = 0; i < size-1; i++) {
+                m.names.push_back(refCast<syntax_tree::Identifier>(e->getStatement(i))->getSymbol());
+            }
+
+            auto body = makeRef<syntax_tree::ListNode>();
+            comp(e->getStatement(size-1), &m, body);
+            emit(body, "RTN");
+            emit(c, "LDF");
+            c->addStatement(body);
+            return;
+        }
+        case NodeKind::Let:
+            compLet(e, n, c, false);
+            return;
+        case NodeKind::Letrec:
+            compLet(e, n, c, true);
+            return;
+        case NodeKind::List:
+            // применение: (COMPLIS (CDR E) N (COMP (CAR E) N (CONS (QUOTE AP) C)))
+            complis(e, 1, n, c);
+            comp(e->getStatement(0), n, c);
+            emit(c, "AP");
+            return;
+        default:
+            break;
+    }
+    throw std::runtime_error("Compile: unexpected " + e->getNodeType());
+}
+
+void SecdCompiler::compBinary(const Node& e, const Names* n, Code& c) {
+    // у CONS аргументы вычисляются в обратном порядке: на вершине стека оказывается голова
+    bool cons = e->getKind() == syntax_tree::NodeKind::Cons;
+    comp(e->getStatement(cons ? 1 : 0), n, c);
+    comp(e->getStatement(cons ? 0 : 1), n, c);
+    emit(c, e->getNodeType());
+}
+
+// список выражений e[from..] в виде LDC NIL e_k CONS ... e_1 CONS
+void SecdCompiler::complis(const Node& e, size_t from, const Names* n, Code& c) {
+    emit(c, "LDC");
+    c->addStatement(syntax_tree::makeNil());
+    for (size_t i = e->getStatementCount(); i > from; i--) {
+        comp(e->getStatement(i-1), n, c);
+        emit(c, "CONS");
+    }
+}
+
+void SecdCompiler::compLet(const Node& e, const Names* n, Code& c, bool recursive) {
+    // VARS и EXPRS: имена и выражения связываний (ASSIGN имя выражение)
+    Names m{{}, n};
+    auto args = makeRef<syntax_tree::ListNode>();
+    args->addStatement(e->getStatement(0));
+    for (size_t i = 1; i < e->getStatementCount(); i++) {
+        auto bind = e->getStatement(i);
+        m.names.push_back(refCast<syntax_tree::Identifier>(bind->getStatement(0))->getSymbol());
+        args->addStatement(bind->getStatement(1));
+    }
+
+    // let вычисляет выражения связываний в N, letrec - в M под DUM
+    if (recursive) {
+        emit(c, "DUM");
+    }
+    complis(args, 1, recursive ? &m : n, c);
+
+    auto body = makeRef<syntax_tree::ListNode>();
+    comp(e->getStatement(0), &m, body);
+    emit(body, "RTN");
+    emit(c, "LDF");
+    c->addStatement(body);
+    emit(c, recursive ? "RAP" : "AP");
+}
+
+SecdCompiler::Node SecdCompiler::location(const Ref<syntax_tree::Identifier>& id, const Names* n) {
+    auto name = id->getSymbol();
+    size_t i = 0;
+    for (; n; n = n->parent, ++i) {
+        for (size_t j = 0; j < n->names.size(); ++j) {
+            if (n->names[j] == name) {
+                auto loc = makeRef<syntax_tree::ListNode>();
+                loc->addStatement(syntax_tree::makeInt((long long)i));
+                loc->addStatement(syntax_tree::makeInt((long long)j));
+                return loc;
+            }
+        }
+    }
+    throw std::runtime_error("Compile: variable '" + id->getValue() + "' not found");
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "AST.h"
+
+// Компилятор AST в код SECD по той же схеме, что COMP/COMPLIS/LOCATION в compiler.lisp:
+// результат печатается (AST::print(true)) в точности как вывод compiler.lisp,
+// но строится за один линейный проход без интерпретации компилятора на Lisp.
+class SecdCompiler {
+private:
+    typedef Ref<syntax_tree::ASTNode> Node;
+    typedef Ref<syntax_tree::ListNode> Code;
+    // N из compiler.lisp: кадр имён и ссылка на объемлющий (nullptr - пустое N).
+    // Кадр лежит в стеке C++ на время компиляции своей формы, поэтому LAMBDA, LET и
+    // LETREC добавляют его без копирования внешних кадров.
+    struct Names {
+        std::vector<syntax_tree::Symbol> names;
+        const Names* parent;
+    };
+
+    void comp(const Node& e, const Names* n, Code& c);
+    void complis(const Node& e, size_t from, const Names* n, Code& c);
+    void compBinary(const Node& e, const Names* n, Code& c);
+    void compLet(const Node& e, const Names* n, Code& c, bool recursive);
+    Node location(const Ref<syntax_tree::Identifier>& id, const Names* n);
+    void emit(Code& c, const std::string& instr);
+
+public:
+    syntax_tree::AST compile(syntax_tree::AST& program);
+};
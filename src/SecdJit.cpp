@@ -0,0 +1,529 @@
+#include "SecdJit.h"
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <set>
+
+#ifdef SECD_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// регистры x86-64: rbx - Context, r12 - top, r13 - начало кучи; остальные - временные
+enum Reg { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSI = 6, RDI = 7, R12 = 12, R13 = 13 };
+// условия jcc/cmovcc
+enum Cond { ALWAYS = -1, O = 0x0, E = 0x4, NE = 0x5, LE = 0xE };
+// опкоды "r/m64, r64"
+enum Alu : unsigned char { ADD = 0x01, OR = 0x09, AND = 0x21, SUB = 0x29, CMP = 0x39, TEST = 0x85, MOV = 0x89 };
+
+// участок не длиннее MAX_INSTRUCTIONS и не глубже MAX_DEPTH значений над входом
+constexpr size_t MAX_INSTRUCTIONS = 2000;
+constexpr int32_t MAX_DEPTH = 64;
+
+}
+
+SecdJit::SecdJit(SecdVM& vm) : vm(vm), entries(vm.code_count), counts(vm.code_count) {}
+
+SecdJit::~SecdJit() {
+#ifdef SECD_JIT
+    for (auto& page : pages) {
+        munmap(page.first, page.second);
+    }
+#endif
+}
+
+std::vector<uint32_t> SecdJit::compile(uint32_t pc) {
+    std::vector<uint32_t> compiled;
+    std::vector<uint32_t> pending = {pc};
+    std::set<uint32_t> seen;
+    while (!pending.empty() && !failed) {
+        uint32_t p = pending.back();
+        pending.pop_back();
+        if (p >= vm.code_count || entries[p].code || !seen.insert(p).second) {
+            continue;
+        }
+        if (segment(p, pending)) {
+            install(p);
+            if (entries[p].code) {
+                compiled.push_back(p);
+            }
+        }
+    }
+    return compiled;
+}
+
+void SecdJit::install(uint32_t pc) {
+#ifdef SECD_JIT
+    // код копируется в отдельные страницы, которые после записи становятся только исполняемыми
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (out.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        failed = true;
+        return;
+    }
+    std::memcpy(memory, out.data(), out.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        failed = true;
+        return;
+    }
+    pages.push_back({memory, size});
+    entries[pc].code = reinterpret_cast<Code>(memory);
+    entries[pc].min_depth = min_depth;
+    entries[pc].max_depth = max_depth;
+#else
+    failed = true;
+#endif
+}
+
+bool SecdJit::segment(uint32_t start, std::vector<uint32_t>& pending) {
+    out.clear();
+    exit_jumps.clear();
+    native = 0;
+    min_depth = 0;
+    max_depth = 0;
+    prologue();
+
+    Branches branches;
+    uint32_t pc = start;
+    int32_t depth = 0;
+    for (;;) {
+        if (native >= MAX_INSTRUCTIONS) {
+            exitTo(ALWAYS, pc, depth);
+        }
+        else if (instruction(pc, depth, branches, pending)) {
+            pc++;
+            continue;
+        }
+        // путь кончился выходом; дальше - отложенные ветви TSEL
+        if (branches.empty()) {
+            break;
+        }
+        bind(branches.back().first, out.size());
+        pc = branches.back().second.first;
+        depth = branches.back().second.second;
+        branches.pop_back();
+    }
+    if (native == 0) {
+        return false;
+    }
+
+    // выходы в интерпретатор: глубина стека в Context, адрес инструкции - результат
+    std::map<std::pair<uint32_t, int32_t>, size_t> stubs;
+    for (auto& exit : exit_jumps) {
+        auto stub = stubs.find(exit.second);
+        if (stub != stubs.end()) {
+            bind(exit.first, stub->second);
+            continue;
+        }
+        stubs[exit.second] = out.size();
+        bind(exit.first, out.size());
+        byte(0x48); byte(0xC7); modrm(0, RBX, offsetof(Context, depth)); imm32(exit.second.second);
+        byte(0xB8); imm32(exit.second.first);
+        epilogue();
+    }
+    return true;
+}
+
+// Компилирует одну инструкцию на глубине depth. false - путь закончен (выход уже записан).
+bool SecdJit::instruction(uint32_t pc, int32_t& depth, Branches& branches, std::vector<uint32_t>& pending) {
+    const SecdVM::Instr& instr = vm.code[pc];
+    auto uses = [&](int32_t pops, int32_t pushes) {
+        if (depth - pops + pushes > MAX_DEPTH) {
+            return false;
+        }
+        min_depth = std::min(min_depth, depth - pops);
+        max_depth = std::max(max_depth, depth - pops + pushes);
+        native++;
+        return true;
+    };
+    // fixnum в обоих операндах: младший бит у обоих равен 1
+    auto bothFixnums = [&]() {
+        loadSlot(RAX, depth - 2);
+        loadSlot(RCX, depth - 1);
+        movReg(RDX, RAX);
+        alu(AND, RDX, RCX);
+        testImm(RDX, 1);
+        exitTo(E, pc, depth);
+    };
+
+    switch (instr.op) {
+        case Op::LD:
+            if (!uses(0, 1)) break;
+            // каждый шаг - по паре: иначе (испорченный код) LD повторяет интерпретатор,
+            // и SecdVM::cell сообщает об ошибке
+            load(RAX, RBX, offsetof(Context, env));
+            for (uint32_t i = 0; i < instr.a; i++) {
+                consCell(RAX, true, pc, depth);
+            }
+            consCell(RAX, false, pc, depth);
+            for (uint32_t j = 0; j < instr.b; j++) {
+                consCell(RAX, true, pc, depth);
+            }
+            consCell(RAX, false, pc, depth);
+            storeSlot(depth++, RAX);
+            return true;
+        case Op::LDC:
+            if (!uses(0, 1)) break;
+            movImm(RAX, vm.constants[instr.a]);
+            storeSlot(depth++, RAX);
+            return true;
+        case Op::LDF:
+            if (!uses(0, 1)) break;
+            movReg(RDI, RBX);
+            movImm(RSI, instr.a);
+            load(RDX, RBX, offsetof(Context, env));
+            call(reinterpret_cast<const void*>(&closureHelper));
+            storeSlot(depth++, RAX);
+            return true;
+        case Op::ADD:
+        case Op::SUB:
+        case Op::MUL:
+            if (!uses(2, 1)) break;
+            bothFixnums();
+            // 2a+1 и 2b+1: переполнение int64 совпадает с выходом результата из диапазона fixnum
+            if (instr.op == Op::ADD) {
+                aluImm(5, RCX, 1);
+                alu(ADD, RAX, RCX);
+                exitTo(O, pc, depth);
+            }
+            else if (instr.op == Op::SUB) {
+                alu(SUB, RAX, RCX);
+                exitTo(O, pc, depth);
+                aluImm(1, RAX, 1);
+            }
+            else {
+                sar1(RAX);
+                aluImm(5, RCX, 1);
+                imul(RAX, RCX);
+                exitTo(O, pc, depth);
+                aluImm(1, RAX, 1);
+            }
+            storeSlot(depth - 2, RAX);
+            depth--;
+            return true;
+        case Op::LE:
+            if (!uses(2, 1)) break;
+            bothFixnums();
+            // сдвиг с единичным тегом сохраняет порядок
+            movImm(RDX, SecdVM::TRUE);
+            alu(CMP, RAX, RCX);
+            movImm(RAX, SecdVM::FALSE);
+            cmov(LE, RAX, RDX);
+            storeSlot(depth - 2, RAX);
+            depth--;
+            return true;
+        case Op::EQUAL: {
+            if (!uses(2, 1)) break;
+            loadSlot(RAX, depth - 2);
+            loadSlot(RCX, depth - 1);
+            alu(CMP, RAX, RCX);
+            size_t different = jump(NE);
+            // равные слова: истина, кроме двух cons (это ошибка, её сообщит интерпретатор)
+            testImm(RAX, 7);
+            exitTo(E, pc, depth);
+            movImm(RAX, SecdVM::TRUE);
+            size_t done = jump(ALWAYS);
+            // разные слова не равны, если среди них есть fixnum, NIL или символ
+            bind(different, out.size());
+            std::vector<size_t> is_false;
+            movReg(RDX, RAX);
+            alu(OR, RDX, RCX);
+            testImm(RDX, 1);
+            is_false.push_back(jump(NE));
+            for (int reg : {RAX, RCX}) {
+                aluImm(7, reg, SecdVM::NIL);
+                is_false.push_back(jump(E));
+                movReg(RDX, reg);
+                aluImm(4, RDX, 7);
+                aluImm(7, RDX, 2);
+                is_false.push_back(jump(E));
+            }
+            exitTo(ALWAYS, pc, depth);
+            for (size_t site : is_false) {
+                bind(site, out.size());
+            }
+            movImm(RAX, SecdVM::FALSE);
+            bind(done, out.size());
+            storeSlot(depth - 2, RAX);
+            depth--;
+            return true;
+        }
+        case Op::CAR:
+        case Op::CDR: {
+            if (!uses(1, 1)) break;
+            loadSlot(RAX, depth - 1);
+            testImm(RAX, 7);
+            size_t not_cons = jump(NE);
+            loadCell(RAX, RAX, instr.op == Op::CDR);
+            storeSlot(depth - 1, RAX);
+            size_t done = jump(ALWAYS);
+            // от NIL остаётся NIL, прочее - ошибка в интерпретаторе
+            bind(not_cons, out.size());
+            aluImm(7, RAX, SecdVM::NIL);
+            exitTo(NE, pc, depth);
+            bind(done, out.size());
+            return true;
+        }
+        case Op::ATOM:
+            if (!uses(1, 1)) break;
+            loadSlot(RCX, depth - 1);
+            movImm(RDX, SecdVM::TRUE);
+            movImm(RAX, SecdVM::FALSE);
+            testImm(RCX, 7);
+            cmov(NE, RAX, RDX);
+            storeSlot(depth - 1, RAX);
+            return true;
+        case Op::CONS: {
+            if (!uses(2, 1)) break;
+            // хвост (глубже) должен быть списком или NIL
+            loadSlot(RDX, depth - 2);
+            loadSlot(RSI, depth - 1);
+            testImm(RDX, 7);
+            size_t list = jump(E);
+            aluImm(7, RDX, SecdVM::NIL);
+            exitTo(NE, pc, depth);
+            bind(list, out.size());
+            movReg(RDI, RBX);
+            call(reinterpret_cast<const void*>(&consHelper));
+            storeSlot(depth - 2, RAX);
+            depth--;
+            return true;
+        }
+        case Op::FRAME:
+            if (!uses(instr.a, 1)) break;
+            movReg(RDI, RBX);
+            lea(RSI, R12, (depth - static_cast<int32_t>(instr.a)) * 8);
+            movImm(RDX, instr.a);
+            call(reinterpret_cast<const void*>(&frameHelper));
+            depth -= instr.a;
+            storeSlot(depth++, RAX);
+            return true;
+        case Op::TSEL: {
+            if (!uses(1, 0)) break;
+            // обе ветви компилируются в этот же участок: в них попадают только отсюда
+            loadSlot(RAX, depth - 1);
+            aluImm(7, RAX, SecdVM::TRUE);
+            size_t then_branch = jump(E);
+            aluImm(7, RAX, SecdVM::FALSE);
+            size_t else_branch = jump(E);
+            exitTo(ALWAYS, pc, depth);
+            branches.push_back({else_branch, {instr.b, depth - 1}});
+            branches.push_back({then_branch, {instr.a, depth - 1}});
+            return false;
+        }
+        case Op::SEL:
+            // ветви SEL и продолжение после JOIN - отдельные входы
+            pending.push_back(instr.a);
+            pending.push_back(instr.b);
+            pending.push_back(pc + 1);
+            break;
+        case Op::AP:
+        case Op::LDAP:
+        case Op::RAP:
+        case Op::DUM:
+        case Op::DIVE:
+        case Op::REM:
+        case Op::LITERAL:
+            // после возврата из вызова (или после инструкции интерпретатора) участок начинается заново
+            pending.push_back(pc + 1);
+            break;
+        default:
+            break;
+    }
+    exitTo(ALWAYS, pc, depth);
+    return false;
+}
+
+SecdJit::Value SecdJit::consHelper(Context* ctx, Value car, Value cdr) {
+    Value v = ctx->vm->cons(car, cdr);
+    ctx->heap = ctx->vm->heap.data();
+    return v;
+}
+
+SecdJit::Value SecdJit::closureHelper(Context* ctx, uint64_t pc, Value env) {
+    Value v = ctx->vm->closure(static_cast<uint32_t>(pc), env);
+    ctx->heap = ctx->vm->heap.data();
+    return v;
+}
+
+SecdJit::Value SecdJit::frameHelper(Context* ctx, const Value* values, uint64_t k) {
+    // как FRAME в интерпретаторе: верхнее значение становится головой списка
+    Value list = SecdVM::NIL;
+    for (uint64_t i = 0; i < k; i++) {
+        list = ctx->vm->cons(values[i], list);
+    }
+    ctx->heap = ctx->vm->heap.data();
+    return list;
+}
+
+void SecdJit::imm32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        byte(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+void SecdJit::imm64(uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        byte(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+// [base + disp32]; r12 в роли базы требует байта SIB
+void SecdJit::modrm(int reg, int base, int32_t disp) {
+    byte(0x80 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == 4) {
+        byte(0x24);
+    }
+    imm32(disp);
+}
+
+void SecdJit::load(int reg, int base, int32_t disp) {
+    byte(0x48 | (reg >> 3) << 2 | (base >> 3));
+    byte(0x8B);
+    modrm(reg, base, disp);
+}
+
+void SecdJit::store(int base, int32_t disp, int reg) {
+    byte(0x48 | (reg >> 3) << 2 | (base >> 3));
+    byte(0x89);
+    modrm(reg, base, disp);
+}
+
+void SecdJit::lea(int reg, int base, int32_t disp) {
+    byte(0x48 | (reg >> 3) << 2 | (base >> 3));
+    byte(0x8D);
+    modrm(reg, base, disp);
+}
+
+void SecdJit::loadSlot(int reg, int32_t slot) {
+    load(reg, R12, slot * 8);
+}
+
+void SecdJit::storeSlot(int32_t slot, int reg) {
+    store(R12, slot * 8, reg);
+}
+
+// reg = car/cdr ячейки value: ячейка по индексу value >> 3 лежит по адресу r13 + value * 2
+void SecdJit::loadCell(int reg, int value, bool cdr) {
+    byte(0x48 | (reg >> 3) << 2 | (value >> 3) << 1 | 1);
+    byte(0x8B);
+    byte(0x84 | (reg & 7) << 3);
+    byte(0x40 | (value & 7) << 3 | (R13 & 7));
+    imm32(cdr ? offsetof(SecdVM::Cell, cdr) : offsetof(SecdVM::Cell, car));
+}
+
+void SecdJit::consCell(int reg, bool cdr, uint32_t pc, int32_t depth) {
+    // не пара - выход в интерпретатор на ту же инструкцию
+    testImm(reg, 7);
+    exitTo(NE, pc, depth);
+    loadCell(reg, reg, cdr);
+}
+
+void SecdJit::movImm(int reg, uint64_t v) {
+    byte(0x48 | (reg >> 3));
+    byte(0xB8 + (reg & 7));
+    imm64(v);
+}
+
+void SecdJit::movReg(int dst, int src) {
+    alu(MOV, dst, src);
+}
+
+void SecdJit::alu(unsigned char opcode, int dst, int src) {
+    byte(0x48 | (src >> 3) << 2 | (dst >> 3));
+    byte(opcode);
+    byte(0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+void SecdJit::imul(int dst, int src) {
+    byte(0x48 | (dst >> 3) << 2 | (src >> 3));
+    byte(0x0F);
+    byte(0xAF);
+    byte(0xC0 | (dst & 7) << 3 | (src & 7));
+}
+
+void SecdJit::sar1(int reg) {
+    byte(0x48 | (reg >> 3));
+    byte(0xD1);
+    byte(0xF8 | (reg & 7));
+}
+
+// группа 0x83/0x81: ext 0 - add, 1 - or, 4 - and, 5 - sub, 7 - cmp
+void SecdJit::aluImm(int ext, int reg, int32_t v) {
+    byte(0x48 | (reg >> 3));
+    if (v >= -128 && v <= 127) {
+        byte(0x83);
+        byte(0xC0 | ext << 3 | (reg & 7));
+        byte(static_cast<unsigned char>(v));
+    }
+    else {
+        byte(0x81);
+        byte(0xC0 | ext << 3 | (reg & 7));
+        imm32(v);
+    }
+}
+
+void SecdJit::testImm(int reg, int32_t v) {
+    byte(0x48 | (reg >> 3));
+    byte(0xF7);
+    byte(0xC0 | (reg & 7));
+    imm32(v);
+}
+
+void SecdJit::cmov(int cc, int dst, int src) {
+    byte(0x48 | (dst >> 3) << 2 | (src >> 3));
+    byte(0x0F);
+    byte(0x40 + cc);
+    byte(0xC0 | (dst & 7) << 3 | (src & 7));
+}
+
+// вызов функции SecdJit (System V: аргументы в rdi, rsi, rdx); куча могла переехать
+void SecdJit::call(const void* function) {
+    movImm(RAX, reinterpret_cast<uint64_t>(function));
+    byte(0xFF);
+    byte(0xD0);
+    load(R13, RBX, offsetof(Context, heap));
+}
+
+// три push выравнивают стек на 16 байт для вызовов
+void SecdJit::prologue() {
+    byte(0x53);
+    byte(0x41); byte(0x54);
+    byte(0x41); byte(0x55);
+    movReg(RBX, RDI);
+    load(R12, RBX, offsetof(Context, top));
+    load(R13, RBX, offsetof(Context, heap));
+}
+
+void SecdJit::epilogue() {
+    byte(0x41); byte(0x5D);
+    byte(0x41); byte(0x5C);
+    byte(0x5B);
+    byte(0xC3);
+}
+
+size_t SecdJit::jump(int cc) {
+    if (cc == ALWAYS) {
+        byte(0xE9);
+    }
+    else {
+        byte(0x0F);
+        byte(0x80 + cc);
+    }
+    size_t at = out.size();
+    imm32(0);
+    return at;
+}
+
+void SecdJit::bind(size_t at, size_t target) {
+    uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+    std::memcpy(&out[at], &rel, sizeof(rel));
+}
+
+void SecdJit::exitTo(int cc, uint32_t pc, int32_t depth) {
+    exit_jumps.push_back({jump(cc), {pc, depth}});
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "SecdVM.h"
+
+// JIT доступен только на x86-64 Linux (GCC/Clang): код пишется в память, полученную mmap.
+// -DSECD_NO_JIT отключает его при сборке, --no-jit - при запуске.
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__)) && !defined(SECD_NO_JIT)
+#define SECD_JIT 1
+#endif
+
+// Компилятор горячих тел LDF в машинный код x86-64.
+// Тело режется на участки: от входа в тело, от начала ветви SEL и от точки возврата
+// после вызова до первой инструкции, которую участок не исполняет сам (вызовы, RTN, SEL, ...).
+// Участок работает прямо со стеком машины: значения лежат в ячейках top[i], глубина
+// относительно входа известна при компиляции. Арифметика над fixnum встроена, проверки тегов
+// и переполнения при неудаче выходят в интерпретатор на ту же инструкцию, которую он
+// выполнит заново общим путём. Выделение ячеек (CONS, FRAME, LDF) идёт через вызовы SecdVM.
+class SecdJit {
+public:
+    typedef SecdVM::Value Value;
+
+    // состояние машины для участка; смещения полей зашиты в генерируемый код
+    struct Context {
+        Value* top;          // стек машины над значениями, бывшими на нём до входа
+        SecdVM::Cell* heap;  // начало кучи, обновляется после каждого выделения
+        Value env;
+        SecdVM* vm;
+        int64_t depth;       // глубина стека относительно top при выходе
+    };
+    typedef uint32_t (*Code)(Context* ctx);
+
+    struct Entry {
+        Code code = nullptr;
+        int32_t min_depth = 0; // сколько значений со стека машины участок может снять (<= 0)
+        int32_t max_depth = 0; // сколько ячеек над top он может занять
+    };
+
+    static constexpr uint32_t THRESHOLD = 1000;
+
+    explicit SecdJit(SecdVM& vm);
+    ~SecdJit();
+    SecdJit(const SecdJit&) = delete;
+    SecdJit& operator=(const SecdJit&) = delete;
+
+    // Компилирует тело, начинающееся с pc, и возвращает адреса входов в готовые участки.
+    std::vector<uint32_t> compile(uint32_t pc);
+    const Entry& entry(uint32_t pc) const { return entries[pc]; }
+    // считает входы в тело; true, когда тело стало горячим
+    bool hot(uint32_t pc) { return ++counts[pc] == THRESHOLD; }
+
+private:
+    typedef SecdVM::Op Op;
+
+    SecdVM& vm;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> counts;
+    std::vector<std::pair<void*, size_t>> pages;
+    bool failed = false;
+
+    // сборка одного участка
+    std::vector<unsigned char> out;
+    std::vector<std::pair<size_t, std::pair<uint32_t, int32_t>>> exit_jumps; // rel32 -> (pc, глубина)
+    size_t native = 0;
+    int32_t min_depth = 0;
+    int32_t max_depth = 0;
+
+    // ветвь TSEL, ждущая компиляции: rel32 перехода -> (начало ветви, глубина)
+    typedef std::vector<std::pair<size_t, std::pair<uint32_t, int32_t>>> Branches;
+
+    bool segment(uint32_t pc, std::vector<uint32_t>& pending);
+    bool instruction(uint32_t pc, int32_t& depth, Branches& branches, std::vector<uint32_t>& pending);
+    void install(uint32_t pc);
+
+    // кодировщик x86-64
+    void byte(unsigned char b) { out.push_back(b); }
+    void imm32(uint32_t v);
+    void imm64(uint64_t v);
+    void modrm(int reg, int base, int32_t disp);
+    void load(int reg, int base, int32_t disp);
+    void store(int base, int32_t disp, int reg);
+    void loadSlot(int reg, int32_t slot);
+    void storeSlot(int32_t slot, int reg);
+    void loadCell(int reg, int value, bool cdr);
+    void consCell(int reg, bool cdr, uint32_t pc, int32_t depth);
+    void lea(int reg, int base, int32_t disp);
+    void movImm(int reg, uint64_t v);
+    void movReg(int dst, int src);
+    void alu(unsigned char opcode, int dst, int src);
+    void imul(int dst, int src);
+    void sar1(int reg);
+    void aluImm(int ext, int reg, int32_t v);
+    void testImm(int reg, int32_t v);
+    void cmov(int cc, int dst, int src);
+    void call(const void* function);
+    void prologue();
+    void epilogue();
+    size_t jump(int cc);
+    void bind(size_t at, size_t target);
+    void exitTo(int cc, uint32_t pc, int32_t depth);
+
+    static Value consHelper(Context* ctx, Value car, Value cdr);
+    static Value closureHelper(Context* ctx, uint64_t pc, Value env);
+    static Value frameHelper(Context* ctx, const Value* values, uint64_t k);
+};
@@ -0,0 +1,76 @@
+#include "SecdNative.h"
+#include "SecdReader.h"
+#include <cstring>
+
+SecdNative::SecdNative(SecdVM& vm, const Image& image) : vm(vm), constants(image.constants) {
+    // то же, что loadBytecode: номера символов и длинных чисел совпадают с таблицами,
+    // ячейки констант (и окружение вычисленной программы) - начало кучи
+    for (uint32_t i = 0; i < image.symbol_count; i++) {
+        vm.symbol(syntax_tree::intern(image.symbols[i]));
+    }
+    for (uint32_t i = 0; i < image.bignum_count; i++) {
+        vm.bignums.push_back(cBigNumber(image.bignums[i], 10));
+    }
+    vm.heap.resize(image.cell_count);
+    if (image.cell_count > 0) {
+        std::memcpy(vm.heap.data(), image.cells, image.cell_count * sizeof(SecdVM::Cell));
+    }
+    vm.pin();
+    vm.constants = image.constants;
+    vm.constant_count = image.constant_count;
+    vm.entry = image.entry;
+    vm.apply = image.apply;
+    vm.resident = image.result;
+}
+
+int SecdNative::main(int argc, char* argv[], const Image& image) {
+    std::string input_file;
+    std::string output_file;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--input=", 8) == 0) {
+            input_file = argv[i] + 8;
+        }
+        else {
+            output_file = argv[i];
+        }
+    }
+
+    SecdVM vm(true, false);
+    syntax_tree::AST result;
+    try {
+        SecdNative native(vm, image);
+        syntax_tree::AST input;
+        if (!input_file.empty()) {
+            input = SecdReader().read(input_file);
+        }
+
+        // как SecdVM::run: программа, затем (AP STOP) над [(input), f]
+        Value value = vm.resident;
+        if (value == SecdVM::OMEGA) {
+            value = native.run(vm.entry);
+        }
+        if (!input.isEmpty() && SecdVM::isClosure(value)) {
+            vm.stack.clear();
+            vm.stack.push_back(vm.cons(vm.toValue(input.getRoot()), SecdVM::NIL));
+            vm.stack.push_back(value);
+            value = native.run(vm.apply);
+        }
+        result = syntax_tree::AST(vm.fromValue(value));
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Evaluation error: `" << e.what() << "`\n";
+        return 1;
+    }
+
+    if (output_file.empty()) {
+        result.print(true);
+        return 0;
+    }
+    std::ofstream file(output_file, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "The file is not open.\n";
+        return 1;
+    }
+    result.print(true, file);
+    return 0;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include "SecdVM.h"
+
+// Среда выполнения программ, переведённых в C++ (main --secd ... --emit-cpp=<file>).
+// Переведённая единица определяет run: инструкции SECD записаны в ней операторами C++,
+// переходы по известным адресам - goto, а по адресам из замыканий и дампа - switch по pc.
+// Здесь - общие шаги машины над кучей, стеком и дампом SecdVM; значения те же, что у неё.
+// Сборка: g++ -std=c++17 -O2 -Isrc prog.cpp src/SecdNative.cpp src/SecdVM.cpp
+//         src/SecdJit.cpp src/SecdReader.cpp src/MappedFile.cpp src/cBigNumber/*.cpp
+struct SecdNative {
+    typedef SecdVM::Value Value;
+    typedef SecdVM::Op Op;
+
+    // адрес возврата для хвостовых форм (TAP, TRAP, TSEL): в дамп ничего не кладётся
+    static constexpr uint32_t NO_RETURN = UINT32_MAX;
+
+    // таблицы, которые записывает переводчик; устроены как секции .secdb
+    struct Image {
+        uint32_t entry;
+        uint32_t apply;
+        Value result;                  // значение вычисленной программы или OMEGA
+        const char* const* symbols;
+        uint32_t symbol_count;
+        const char* const* bignums;
+        uint32_t bignum_count;
+        const uint64_t* cells;         // car, cdr подряд
+        uint32_t cell_count;
+        const Value* constants;
+        uint32_t constant_count;
+    };
+
+    SecdVM& vm;
+    const Value* constants;
+
+    SecdNative(SecdVM& vm, const Image& image);
+
+    // определяется переведённой программой
+    Value run(uint32_t pc);
+
+    // разбор аргументов (<output_file>, --input=<file>), выполнение и печать результата
+    static int main(int argc, char* argv[], const Image& image);
+
+    void push(Value v) { vm.stack.push_back(v); }
+    Value pop() { return vm.pop(); }
+
+    Value ld(uint32_t i, uint32_t j) {
+        Value e = vm.env;
+        for (; i > 0; i--) {
+            e = vm.cell(e).cdr;
+        }
+        Value frame = vm.cell(e).car;
+        for (; j > 0; j--) {
+            frame = vm.cell(frame).cdr;
+        }
+        return vm.cell(frame).car;
+    }
+
+    // AP/TAP: новый кадр (args . окружение замыкания), результат - адрес тела;
+    // вызовы - точки сборки мусора, как и в SecdVM::execute
+    uint32_t call(Value f, uint32_t ret) {
+        Value args = pop();
+        if (!SecdVM::isClosure(f)) {
+            throw std::runtime_error("Function call: first element must be a closure");
+        }
+        if (ret != NO_RETURN) {
+            vm.dump.push_back({vm.stack.size(), vm.env, ret});
+        }
+        uint32_t pc = SecdVM::fixnumValue(vm.cell(f).car);
+        vm.env = vm.cons(args, vm.cell(f).cdr);
+        vm.safepoint();
+        return pc;
+    }
+
+    // RAP/TRAP: кадр OMEGA, созданный DUM, заменяется значениями
+    uint32_t recursiveCall(uint32_t ret) {
+        Value f = pop();
+        Value args = pop();
+        if (!SecdVM::isClosure(f) || !SecdVM::isCons(vm.cell(f).cdr) || vm.cell(vm.cell(f).cdr).car != SecdVM::OMEGA) {
+            throw std::runtime_error("Secd: RAP expects a closure over a DUM frame");
+        }
+        Value frame = vm.cell(f).cdr;
+        if (ret != NO_RETURN) {
+            vm.dump.push_back({vm.stack.size(), vm.cell(vm.env).cdr, ret});
+        }
+        vm.cell(frame).car = args;
+        vm.env = frame;
+        uint32_t pc = SecdVM::fixnumValue(vm.cell(f).car);
+        vm.safepoint();
+        return pc;
+    }
+
+    uint32_t rtn() {
+        Value result = pop();
+        if (vm.dump.empty()) {
+            throw std::runtime_error("Secd: RTN with empty dump");
+        }
+        SecdVM::DumpEntry d = vm.dump.back();
+        vm.dump.pop_back();
+        vm.stack.resize(d.sp);
+        vm.stack.push_back(result);
+        vm.env = d.env;
+        return d.pc;
+    }
+
+    uint32_t join() {
+        if (vm.dump.empty()) {
+            throw std::runtime_error("Secd: JOIN with empty dump");
+        }
+        uint32_t pc = vm.dump.back().pc;
+        vm.dump.pop_back();
+        return pc;
+    }
+
+    // SEL/TSEL: true - ветвь then
+    bool select(uint32_t ret) {
+        Value test = pop();
+        if (test != SecdVM::TRUE && test != SecdVM::FALSE) {
+            throw std::runtime_error("Cond error!");
+        }
+        if (ret != NO_RETURN) {
+            vm.dump.push_back({vm.stack.size(), vm.env, ret});
+        }
+        return test == SecdVM::TRUE;
+    }
+
+    void dum() {
+        vm.env = vm.cons(SecdVM::OMEGA, vm.env);
+    }
+
+    Value stop() {
+        return vm.stack.empty() ? SecdVM::NIL : vm.stack.back();
+    }
+
+    void unary(Op op) {
+        Value v = pop();
+        if ((op == Op::CAR || op == Op::CDR) && SecdVM::isCons(v)) {
+            push((op == Op::CAR) ? vm.cell(v).car : vm.cell(v).cdr);
+            return;
+        }
+        push(vm.applyUnary(op, v));
+    }
+
+    void binary(Op op) {
+        Value right = pop();
+        Value left = pop();
+        if (SecdVM::isFixnum(left) && SecdVM::isFixnum(right)) {
+            int64_t a = SecdVM::fixnumValue(left), b = SecdVM::fixnumValue(right);
+            switch (op) {
+                case Op::ADD:
+                    if (a + b >= SecdVM::FIXNUM_MIN && a + b <= SecdVM::FIXNUM_MAX) {
+                        push(SecdVM::fixnum(a + b));
+                        return;
+                    }
+                    break;
+                case Op::SUB:
+                    if (a - b >= SecdVM::FIXNUM_MIN && a - b <= SecdVM::FIXNUM_MAX) {
+                        push(SecdVM::fixnum(a - b));
+                        return;
+                    }
+                    break;
+                case Op::LE:
+                    push(SecdVM::boolean(a <= b));
+                    return;
+                case Op::EQUAL:
+                    push(SecdVM::boolean(a == b));
+                    return;
+                default:
+                    break;
+            }
+        }
+        push(vm.applyBinary(op, left, right));
+    }
+
+    void frame(uint32_t k) {
+        if (k > vm.stack.size()) {
+            throw std::runtime_error("Secd: stack underflow");
+        }
+        size_t base = vm.stack.size() - k;
+        Value list = SecdVM::NIL;
+        for (size_t i = base; i < vm.stack.size(); i++) {
+            list = vm.cons(vm.stack[i], list);
+        }
+        vm.stack.resize(base);
+        vm.stack.push_back(list);
+    }
+};
@@ -0,0 +1,109 @@
+#include "SecdReader.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+syntax_tree::AST SecdReader::read(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+    pos = 0;
+    tree = syntax_tree::AST();
+
+    auto root = readExpr();
+    skipSpace();
+    if (pos != text.size()) {
+        throw std::runtime_error("Secd reader: unexpected text after expression");
+    }
+    tree.setRoot(root);
+    return tree;
+}
+
+void SecdReader::skipSpace() {
+    while (pos < text.size()) {
+        if (std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+        else if (text[pos] == ';') {
+            while (pos < text.size() && text[pos] != '\n') {
+                pos++;
+            }
+        }
+        else {
+            break;
+        }
+    }
+}
+
+Ref<syntax_tree::ASTNode> SecdReader::readExpr() {
+    skipSpace();
+    if (pos == text.size()) {
+        throw std::runtime_error("Secd reader: unexpected end of file");
+    }
+    if (text[pos] == ')') {
+        throw std::runtime_error("Secd reader: unexpected ')'");
+    }
+    if (text[pos] != '(') {
+        return readAtom();
+    }
+
+    pos++;
+    std::vector<Ref<syntax_tree::ASTNode>> items;
+    for (;;) {
+        skipSpace();
+        if (pos == text.size()) {
+            throw std::runtime_error("Secd reader: missing ')'");
+        }
+        if (text[pos] == ')') {
+            pos++;
+            break;
+        }
+        items.push_back(readExpr());
+    }
+    // пустой список, как и в grammar.y, равен NIL
+    if (items.empty()) {
+        return syntax_tree::makeNil();
+    }
+    auto list = tree.make<syntax_tree::ListNode>();
+    list->setStatements(std::move(items));
+    return list;
+}
+
+Ref<syntax_tree::ASTNode> SecdReader::readAtom() {
+    size_t start = pos;
+    while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos]))
+            && text[pos] != '(' && text[pos] != ')' && text[pos] != ';') {
+        pos++;
+    }
+    std::string word = text.substr(start, pos - start);
+
+    size_t digits = (word[0] == '-') ? 1 : 0;
+    if (digits < word.size() && std::all_of(word.begin() + digits, word.end(), ::isdigit)) {
+        return tree.makeInt(cBigNumber(word.c_str(), 10));
+    }
+
+    std::string upper = word;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    if (upper == "NIL") {
+        return syntax_tree::makeNil();
+    }
+    if (upper == "TRUE" || upper == "FALSE") {
+        return syntax_tree::makeBool(upper == "TRUE");
+    }
+
+    // ключевые слова регистронезависимы, как в lexer.l; прочие имена - нет
+    static const char* keywords[] = {
+        "QUOTE", "CAR", "CDR", "CONS", "ATOM", "LITERAL", "EQUAL", "ADD", "SUB", "MUL",
+        "DIVE", "REM", "LE", "COND", "LAMBDA", "LET", "LETREC"
+    };
+    for (const char* keyword : keywords) {
+        if (upper == keyword) {
+            return tree.make<syntax_tree::Identifier>(upper);
+        }
+    }
+    return tree.make<syntax_tree::Identifier>(word);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include "AST.h"
+
+// Чтение плоского S-выражения, которое пишет AST::print(true): код SECD (.secd)
+// или данные для него. Грамматика grammar.y здесь не подходит, так как в коде SECD
+// ключевые слова (CONS, ADD, ...) стоят как обычные атомы.
+// Списки читаются в ListNode, числа в LiteralInt, NIL/TRUE/FALSE в константы,
+// остальные атомы в Identifier; ключевые слова Lisp приводятся к верхнему регистру.
+class SecdReader {
+private:
+    std::string text;
+    size_t pos = 0;
+    // узлы создаются в арене читаемого дерева
+    syntax_tree::AST tree;
+
+    void skipSpace();
+    Ref<syntax_tree::ASTNode> readExpr();
+    Ref<syntax_tree::ASTNode> readAtom();
+
+public:
+    syntax_tree::AST read(const std::string& filename);
+};
@@ -0,0 +1,1079 @@
+#include "SecdVM.h"
+#include "SecdJit.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+SecdVM::SecdVM(bool optimize, bool jit) : optimize(optimize), use_jit(jit) {}
+
+SecdVM::~SecdVM() = default;
+
+void SecdVM::load(syntax_tree::AST program) {
+    if (program.isEmpty()) {
+        throw std::runtime_error("Secd: program is empty");
+    }
+    resident = OMEGA;
+    entry = loadBlock(program.getRoot(), false);
+    apply = code_storage.size();
+    code_storage.push_back({Op::AP});
+    code_storage.push_back({Op::STOP});
+
+    code = code_storage.data();
+    code_count = code_storage.size();
+    constants = constant_storage.data();
+    constant_count = constant_storage.size();
+    pin();
+    predecode();
+}
+
+syntax_tree::AST SecdVM::run(syntax_tree::AST input) {
+    if (!code) {
+        throw std::runtime_error("Secd: no program loaded");
+    }
+    Value result = resident;
+    if (result == OMEGA) {
+        stack.clear();
+        dump.clear();
+        env = NIL;
+        result = execute(entry);
+    }
+
+    if (!input.isEmpty() && isClosure(result)) {
+        // (AP STOP) над стеком [(input), f]
+        stack.clear();
+        stack.push_back(cons(toValue(input.getRoot()), NIL));
+        stack.push_back(result);
+        result = execute(apply);
+    }
+    return syntax_tree::AST(fromValue(result));
+}
+
+void SecdVM::evaluate() {
+    if (!code) {
+        throw std::runtime_error("Secd: no program loaded");
+    }
+    resident = OMEGA;
+    stack.clear();
+    dump.clear();
+    env = NIL;
+    resident = execute(entry);
+}
+
+namespace {
+
+size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+void writeStrings(std::string& out, const std::vector<std::string>& strings) {
+    for (const auto& str : strings) {
+        uint32_t length = str.size();
+        out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.append(str);
+    }
+}
+
+std::vector<std::string> readStrings(const char* begin, const char* end, uint32_t count) {
+    std::vector<std::string> strings;
+    const char* p = begin;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length;
+        if (end - p < static_cast<ptrdiff_t>(sizeof(length))) {
+            throw std::runtime_error("Secd bytecode: truncated string table");
+        }
+        std::memcpy(&length, p, sizeof(length));
+        p += sizeof(length);
+        if (end - p < static_cast<ptrdiff_t>(length)) {
+            throw std::runtime_error("Secd bytecode: truncated string table");
+        }
+        strings.emplace_back(p, length);
+        p += length;
+    }
+    return strings;
+}
+
+}
+
+bool SecdVM::isBytecode(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(BYTECODE_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) == 0;
+}
+
+void SecdVM::saveBytecode(const std::string& filename) {
+    if (!code) {
+        throw std::runtime_error("Secd: no program loaded");
+    }
+    // в куче ячейки констант, а после evaluate - и всё, что построила программа;
+    // в образ попадает только то, что достижимо из результата
+    stack.clear();
+    dump.clear();
+    env = NIL;
+    collect();
+    std::vector<std::string> symbol_names;
+    for (auto name : symbols) {
+        symbol_names.push_back(*name);
+    }
+    std::vector<std::string> bignum_texts;
+    for (const auto& n : bignums) {
+        std::ostringstream text;
+        text << n;
+        bignum_texts.push_back(text.str());
+    }
+
+    BytecodeHeader header = {};
+    std::memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+    header.version = BYTECODE_VERSION;
+    header.entry = entry;
+    header.apply = apply;
+    header.code_count = code_count;
+    header.constant_count = constant_count;
+    header.cell_count = heap.size();
+    header.symbol_count = symbol_names.size();
+    header.bignum_count = bignum_texts.size();
+    header.result = resident;
+
+    std::string out(sizeof(header), '\0');
+    auto section = [&](const void* data, size_t size) {
+        out.resize(align8(out.size()), '\0');
+        uint64_t offset = out.size();
+        out.append(static_cast<const char*>(data), size);
+        return offset;
+    };
+    header.code_offset = section(code, code_count * sizeof(Instr));
+    header.constant_offset = section(constants, constant_count * sizeof(Value));
+    header.cell_offset = section(heap.data(), heap.size() * sizeof(Cell));
+    out.resize(align8(out.size()), '\0');
+    header.symbol_offset = out.size();
+    writeStrings(out, symbol_names);
+    header.bignum_offset = out.size();
+    writeStrings(out, bignum_texts);
+    std::memcpy(&out[0], &header, sizeof(header));
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    file.write(out.data(), out.size());
+}
+
+void SecdVM::loadBytecode(const std::string& filename) {
+    image = std::make_unique<MappedFile>(filename);
+    const char* base = image->data();
+    size_t size = image->size();
+
+    BytecodeHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Secd bytecode: file too short");
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, BYTECODE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Secd bytecode: bad magic");
+    }
+    if (header.version != BYTECODE_VERSION) {
+        throw std::runtime_error("Secd bytecode: unsupported version " + std::to_string(header.version));
+    }
+    auto inside = [&](uint64_t offset, uint64_t bytes) {
+        return offset % 8 == 0 && offset <= size && bytes <= size - offset;
+    };
+    if (!inside(header.code_offset, uint64_t(header.code_count) * sizeof(Instr))
+            || !inside(header.constant_offset, uint64_t(header.constant_count) * sizeof(Value))
+            || !inside(header.cell_offset, uint64_t(header.cell_count) * sizeof(Cell))
+            || header.symbol_offset > size || header.bignum_offset > size
+            || header.entry >= header.code_count || header.apply + 1 >= header.code_count) {
+        throw std::runtime_error("Secd bytecode: corrupt header");
+    }
+
+    // код и константы не копируются: машина читает их прямо из отображения
+    auto image_code = reinterpret_cast<const Instr*>(base + header.code_offset);
+    for (uint32_t i = 0; i < header.code_count; i++) {
+        const Instr& instr = image_code[i];
+        bool ok = instr.op <= Op::FRAME;
+        if (instr.op == Op::LDC) ok = instr.a < header.constant_count;
+        if (instr.op == Op::LDF) ok = instr.a < header.code_count;
+        if (instr.op == Op::SEL || instr.op == Op::TSEL) ok = instr.a < header.code_count && instr.b < header.code_count;
+        if (!ok) {
+            throw std::runtime_error("Secd bytecode: bad instruction at " + std::to_string(i));
+        }
+    }
+
+    // значения в ячейках, константах и result ссылаются только внутрь образа
+    auto cells = reinterpret_cast<const Cell*>(base + header.cell_offset);
+    auto valid = [&](Value v) {
+        if (isFixnum(v)) return true;
+        uint64_t index = v >> 3;
+        if (isCons(v)) return index < header.cell_count;
+        if (isSymbol(v)) return index < header.symbol_count;
+        if (isClosure(v)) {
+            return index < header.cell_count && isFixnum(cells[index].car)
+                && static_cast<uint64_t>(fixnumValue(cells[index].car)) < header.code_count;
+        }
+        return index <= (OMEGA >> 3) || index - FIRST_BIG < header.bignum_count;
+    };
+    auto image_constants = reinterpret_cast<const Value*>(base + header.constant_offset);
+    bool values_ok = valid(header.result);
+    for (uint32_t i = 0; values_ok && i < header.constant_count; i++) {
+        values_ok = valid(image_constants[i]);
+    }
+    for (uint32_t i = 0; values_ok && i < header.cell_count; i++) {
+        values_ok = valid(cells[i].car) && valid(cells[i].cdr);
+    }
+    if (!values_ok) {
+        throw std::runtime_error("Secd bytecode: bad value");
+    }
+
+    // изменяемая часть: ячейки констант становятся началом кучи, номера символов
+    // и длинных чисел в значениях совпадают с номерами в таблицах
+    heap.resize(header.cell_count);
+    std::memcpy(heap.data(), cells, header.cell_count * sizeof(Cell));
+    symbols.clear();
+    symbol_ids.clear();
+    for (const auto& name : readStrings(base + header.symbol_offset, base + size, header.symbol_count)) {
+        symbol(syntax_tree::intern(name));
+    }
+    bignums.clear();
+    for (const auto& text : readStrings(base + header.bignum_offset, base + size, header.bignum_count)) {
+        bignums.push_back(cBigNumber(text.c_str(), 10));
+    }
+
+    code = image_code;
+    code_count = header.code_count;
+    constants = image_constants;
+    constant_count = header.constant_count;
+    entry = header.entry;
+    apply = header.apply;
+    resident = header.result;
+    pin();
+    predecode();
+}
+
+void SecdVM::pin() {
+    pinned = heap.size();
+    heap_limit = std::max(MIN_HEAP, 2 * pinned);
+    heap.reserve(heap_limit);
+    pinned_bignums = bignums.size();
+    bignum_limit = std::max(MIN_BIGNUMS, 2 * pinned_bignums);
+}
+
+SecdVM::Value SecdVM::cons(Value car, Value cdr) {
+    heap.push_back({car, cdr});
+    return static_cast<Value>(heap.size() - 1) << 3;
+}
+
+SecdVM::Value SecdVM::closure(uint32_t pc, Value env) {
+    heap.push_back({fixnum(pc), env});
+    return static_cast<Value>(heap.size() - 1) << 3 | 6;
+}
+
+SecdVM::Value SecdVM::symbol(syntax_tree::Symbol name) {
+    auto it = symbol_ids.find(name);
+    if (it == symbol_ids.end()) {
+        it = symbol_ids.emplace(name, static_cast<uint32_t>(symbols.size())).first;
+        symbols.push_back(name);
+    }
+    return static_cast<Value>(it->second) << 3 | 2;
+}
+
+SecdVM::Value SecdVM::integer(const cBigNumber& n) {
+    // как и LiteralInt, числа нормализованы: что помещается в fixnum, не хранится длинным
+    if (n.bits() < 63) {
+        return fixnum(static_cast<int64_t>(n.toCBNL()));
+    }
+    bignums.push_back(n);
+    return static_cast<Value>(bignums.size() - 1 + FIRST_BIG) << 3 | 4;
+}
+
+cBigNumber SecdVM::bigValue(Value v) {
+    if (isFixnum(v)) {
+        return cBigNumber(static_cast<CBNL>(fixnumValue(v)));
+    }
+    return bignums[(v >> 3) - FIRST_BIG];
+}
+
+uint32_t SecdVM::loadBlock(const Ref<syntax_tree::ASTNode>& block, bool tail) {
+    static const std::unordered_map<std::string, Op> opcodes = {
+        {"LD", Op::LD}, {"LDC", Op::LDC}, {"LDF", Op::LDF}, {"AP", Op::AP}, {"RTN", Op::RTN},
+        {"SEL", Op::SEL}, {"JOIN", Op::JOIN}, {"DUM", Op::DUM}, {"RAP", Op::RAP}, {"STOP", Op::STOP},
+        {"CAR", Op::CAR}, {"CDR", Op::CDR}, {"ATOM", Op::ATOM}, {"LITERAL", Op::LITERAL},
+        {"CONS", Op::CONS}, {"ADD", Op::ADD}, {"SUB", Op::SUB}, {"MUL", Op::MUL},
+        {"DIVE", Op::DIVE}, {"REM", Op::REM}, {"LE", Op::LE}, {"EQUAL", Op::EQUAL}
+    };
+
+    if (block->getKind() != syntax_tree::NodeKind::List) {
+        throw std::runtime_error("Secd: code block must be a list");
+    }
+    auto items = block->getStatements();
+
+    // пока блок не размещён, a и b у LDF/SEL - номера вложенных блоков в blocks
+    std::vector<Instr> instrs;
+    std::vector<SubBlock> blocks;
+
+    auto operand = [&](size_t& i) -> Ref<syntax_tree::ASTNode> {
+        if (++i >= items.size()) {
+            throw std::runtime_error("Secd: missing operand");
+        }
+        return items[i];
+    };
+
+    for (size_t i = 0; i < items.size(); i++) {
+        auto name = syntax_tree::node_cast<syntax_tree::Identifier>(items[i]);
+        auto it = name ? opcodes.find(name->getValue()) : opcodes.end();
+        if (it == opcodes.end()) {
+            throw std::runtime_error("Secd: unknown instruction");
+        }
+        Instr instr{it->second};
+        switch (instr.op) {
+            case Op::LD: {
+                auto location = operand(i);
+                auto frame = syntax_tree::node_cast<syntax_tree::LiteralInt>(location->getStatement(0));
+                auto slot = syntax_tree::node_cast<syntax_tree::LiteralInt>(location->getStatement(1));
+                if (!frame || !slot) {
+                    throw std::runtime_error("Secd: LD expects (i j)");
+                }
+                instr.a = frame->getSmall();
+                instr.b = slot->getSmall();
+                break;
+            }
+            case Op::LDC:
+                instr.a = constant_storage.size();
+                constant_storage.push_back(toValue(operand(i)));
+                break;
+            case Op::LDF:
+                instr.a = blocks.size();
+                blocks.push_back({operand(i), false});
+                break;
+            case Op::SEL:
+                instr.a = blocks.size();
+                blocks.push_back({operand(i), false});
+                instr.b = blocks.size();
+                blocks.push_back({operand(i), false});
+                break;
+            default:
+                break;
+        }
+        instrs.push_back(instr);
+    }
+
+    // ветвь SEL в хвостовой позиции возвращает значение сама: JOIN становится RTN
+    if (tail && !instrs.empty() && instrs.back().op == Op::JOIN) {
+        instrs.back().op = Op::RTN;
+    }
+    if (optimize) {
+        peephole(instrs, blocks);
+    }
+
+    // вложенные блоки размещаются после текущего, чтобы он остался непрерывным
+    uint32_t start = code_storage.size();
+    code_storage.insert(code_storage.end(), instrs.begin(), instrs.end());
+    for (size_t i = start; i < start + instrs.size(); i++) {
+        Op op = code_storage[i].op;
+        if (op == Op::LDF || op == Op::SEL || op == Op::TSEL) {
+            uint32_t a = loadBlock(blocks[code_storage[i].a].code, blocks[code_storage[i].a].tail);
+            code_storage[i].a = a;
+        }
+        if (op == Op::SEL || op == Op::TSEL) {
+            uint32_t b = loadBlock(blocks[code_storage[i].b].code, blocks[code_storage[i].b].tail);
+            code_storage[i].b = b;
+        }
+    }
+    return start;
+}
+
+void SecdVM::peephole(std::vector<Instr>& instrs, std::vector<SubBlock>& blocks) {
+    // хвостовые формы: SEL перед RTN не сохраняет продолжение в дампе, его ветви
+    // заканчиваются RTN; AP и RAP перед RTN не создают запись дампа
+    if (instrs.size() >= 2 && instrs.back().op == Op::RTN) {
+        Instr& last = instrs[instrs.size() - 2];
+        bool fused = true;
+        switch (last.op) {
+            case Op::SEL:
+                last.op = Op::TSEL;
+                blocks[last.a].tail = true;
+                blocks[last.b].tail = true;
+                break;
+            case Op::AP:  last.op = Op::TAP; break;
+            case Op::RAP: last.op = Op::TRAP; break;
+            default:      fused = false; break;
+        }
+        if (fused) {
+            instrs.pop_back();
+        }
+    }
+
+    foldConstants(instrs);
+    buildFrames(instrs);
+
+    // LD (i j) AP: функция берётся прямо из окружения
+    std::vector<Instr> out;
+    for (size_t i = 0; i < instrs.size(); i++) {
+        if (instrs[i].op == Op::LD && i + 1 < instrs.size()
+                && (instrs[i + 1].op == Op::AP || instrs[i + 1].op == Op::TAP)) {
+            Instr fused = instrs[i];
+            fused.op = (instrs[i + 1].op == Op::AP) ? Op::LDAP : Op::LDTAP;
+            out.push_back(fused);
+            i++;
+            continue;
+        }
+        out.push_back(instrs[i]);
+    }
+    instrs.swap(out);
+}
+
+void SecdVM::foldConstants(std::vector<Instr>& instrs) {
+    auto isUnary = [](Op op) {
+        return op == Op::CAR || op == Op::CDR || op == Op::ATOM || op == Op::LITERAL;
+    };
+    auto isBinary = [](Op op) {
+        return op == Op::CONS || (op >= Op::ADD && op <= Op::EQUAL);
+    };
+
+    // свёртка идёт по выходному вектору, поэтому LDC 1 LDC 2 ADD LDC 3 MUL сворачивается целиком
+    std::vector<Instr> out;
+    for (const Instr& instr : instrs) {
+        out.push_back(instr);
+        size_t n = out.size();
+        try {
+            if (isUnary(instr.op) && n >= 2 && out[n - 2].op == Op::LDC) {
+                Value v = applyUnary(instr.op, constant_storage[out[n - 2].a]);
+                out.pop_back();
+                out.back().a = constant_storage.size();
+                constant_storage.push_back(v);
+            }
+            else if (isBinary(instr.op) && n >= 3 && out[n - 2].op == Op::LDC && out[n - 3].op == Op::LDC) {
+                Value v = applyBinary(instr.op, constant_storage[out[n - 3].a], constant_storage[out[n - 2].a]);
+                out.pop_back();
+                out.pop_back();
+                out.back().a = constant_storage.size();
+                constant_storage.push_back(v);
+            }
+        }
+        catch (const std::runtime_error&) {
+            // ошибка остаётся на время выполнения
+        }
+    }
+    instrs.swap(out);
+}
+
+void SecdVM::buildFrames(std::vector<Instr>& instrs) {
+    // Список аргументов COMPLIS: LDC NIL, e_k, CONS, ..., e_1, CONS. Значения e_i
+    // оставляются на стеке, а список собирается одной инструкцией FRAME k на месте
+    // последнего CONS. Глубина стека отслеживается внутри блока; незнакомая форма
+    // блока оставляет его без изменений.
+    struct Open { size_t ldc; int position; std::vector<size_t> conses; };
+    std::vector<Open> open;
+    std::vector<bool> removed(instrs.size(), false);
+    std::vector<Instr> replaced = instrs;
+    int depth = 0;
+
+    auto close = [&](Open& list) {
+        if (list.conses.empty()) {
+            return;
+        }
+        removed[list.ldc] = true;
+        for (size_t i = 0; i + 1 < list.conses.size(); i++) {
+            removed[list.conses[i]] = true;
+        }
+        replaced[list.conses.back()].op = Op::FRAME;
+        replaced[list.conses.back()].a = list.conses.size();
+    };
+    // значения, снятые со стека инструкцией, перестают быть открытыми списками
+    auto consume = [&](int pops) {
+        while (!open.empty() && open.back().position >= depth - pops) {
+            close(open.back());
+            open.pop_back();
+        }
+    };
+
+    for (size_t i = 0; i < instrs.size(); i++) {
+        const Instr& instr = instrs[i];
+        int pops = 0, pushes = 0;
+        bool end = false;
+        switch (instr.op) {
+            case Op::LD: case Op::LDC: case Op::LDF:
+                pushes = 1; break;
+            case Op::CAR: case Op::CDR: case Op::ATOM: case Op::LITERAL:
+            case Op::SEL: case Op::LDAP:
+                pops = 1; pushes = 1; break;
+            case Op::AP: case Op::RAP: case Op::CONS:
+            case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIVE: case Op::REM: case Op::LE: case Op::EQUAL:
+                pops = 2; pushes = 1; break;
+            case Op::FRAME:
+                pops = instr.a; pushes = 1; break;
+            case Op::DUM:
+                break;
+            case Op::RTN: case Op::JOIN: case Op::STOP: case Op::TSEL:
+                pops = 1; end = true; break;
+            case Op::TAP: case Op::TRAP:
+                pops = 2; end = true; break;
+            default:
+                return;
+        }
+        if (depth < pops) {
+            return;
+        }
+
+        if (instr.op == Op::CONS) {
+            // открытый список в роли car - это элемент другого списка
+            if (!open.empty() && open.back().position == depth - 1) {
+                close(open.back());
+                open.pop_back();
+            }
+            // CONS на открытый список: результат остаётся на его месте
+            if (!open.empty() && open.back().position == depth - 2) {
+                open.back().conses.push_back(i);
+                depth -= 1;
+                continue;
+            }
+        }
+        consume(pops);
+        if (end) {
+            break;
+        }
+        depth += pushes - pops;
+        if (instr.op == Op::LDC && constant_storage[instr.a] == NIL) {
+            open.push_back({i, depth - 1, {}});
+        }
+    }
+    // списки, дошедшие до конца блока без потребителя, не трогаются
+
+    std::vector<Instr> out;
+    for (size_t i = 0; i < replaced.size(); i++) {
+        if (!removed[i]) {
+            out.push_back(replaced[i]);
+        }
+    }
+    instrs.swap(out);
+}
+
+SecdVM::Value SecdVM::toValue(const Ref<syntax_tree::ASTNode>& node) {
+    using syntax_tree::NodeKind;
+
+    switch (node->getKind()) {
+        case NodeKind::LiteralInt: {
+            auto n = refCast<syntax_tree::LiteralInt>(node);
+            return n->isSmall() ? integer(cBigNumber(static_cast<CBNL>(n->getSmall()))) : integer(n->getValue());
+        }
+        case NodeKind::LiteralBool:
+            return boolean(refCast<syntax_tree::LiteralBool>(node)->getValue());
+        case NodeKind::LiteralNil:
+            return NIL;
+        case NodeKind::Identifier:
+            return symbol(refCast<syntax_tree::Identifier>(node)->getSymbol());
+        case NodeKind::List: {
+            auto items = node->getStatements();
+            Value result = NIL;
+            for (auto it = items.rbegin(); it != items.rend(); ++it) {
+                result = cons(toValue(*it), result);
+            }
+            return result;
+        }
+        case NodeKind::Pair: {
+            std::vector<Ref<syntax_tree::ASTNode>> items;
+            syntax_tree::Value p = syntax_tree::Value::box(node);
+            for (; p.getKind() == NodeKind::Pair; p = static_cast<syntax_tree::PairNode*>(p.node())->getCdr()) {
+                items.push_back(static_cast<syntax_tree::PairNode*>(p.node())->getCar().toNode());
+            }
+            Value result = NIL;
+            for (auto it = items.rbegin(); it != items.rend(); ++it) {
+                result = cons(toValue(*it), result);
+            }
+            return result;
+        }
+        case NodeKind::FuncClosure:
+        case NodeKind::Node:
+        case NodeKind::Assign:
+        case NodeKind::Closure:
+        case NodeKind::Omega:
+            break;
+        default:
+            // ключевое слово из quote (ADD, CAR, ...) - символ с именем типа узла
+            if (node->getStatementCount() == 0) {
+                return symbol(syntax_tree::intern(node->getNodeType()));
+            }
+            break;
+    }
+    throw std::runtime_error("Secd: value cannot be loaded");
+}
+
+Ref<syntax_tree::ASTNode> SecdVM::fromValue(Value v) {
+    if (isInt(v)) {
+        return isFixnum(v) ? syntax_tree::makeInt(static_cast<long long>(fixnumValue(v))) : syntax_tree::makeInt(bigValue(v));
+    }
+    if (isCons(v)) {
+        std::vector<Value> items;
+        for (; isCons(v); v = cell(v).cdr) {
+            items.push_back(cell(v).car);
+        }
+        Ref<syntax_tree::ASTNode> result = syntax_tree::makeNil();
+        for (auto it = items.rbegin(); it != items.rend(); ++it) {
+            result = makeRef<syntax_tree::PairNode>(syntax_tree::Value::fromNode(fromValue(*it)),
+                                                   syntax_tree::Value::box(result));
+        }
+        return result;
+    }
+    if (isSymbol(v)) {
+        return makeRef<syntax_tree::Identifier>(symbols[v >> 3]);
+    }
+    if (isClosure(v)) {
+        return makeRef<syntax_tree::ASTNode>(syntax_tree::NodeKind::Closure);
+    }
+    switch (v) {
+        case NIL:   return syntax_tree::makeNil();
+        case TRUE:  return syntax_tree::makeBool(true);
+        case FALSE: return syntax_tree::makeBool(false);
+        default:    return makeRef<syntax_tree::ASTNode>(syntax_tree::NodeKind::Omega);
+    }
+}
+
+SecdVM::Value SecdVM::pop() {
+    if (stack.empty()) {
+        throw std::runtime_error("Secd: stack underflow");
+    }
+    Value v = stack.back();
+    stack.pop_back();
+    return v;
+}
+
+void SecdVM::collect() {
+    // закреплённые ячейки переходят в новую кучу на те же места и сканируются вместе
+    // с копиями, так что ссылка из них в подвижную часть (после RAP) тоже обновится
+    ToSpace to;
+    to.cells.reserve(heap.size());
+    to.cells.assign(heap.begin(), heap.begin() + pinned);
+    to.bignums.assign(bignums.begin(), bignums.begin() + pinned_bignums);
+    to.moved.assign(bignums.size() - pinned_bignums, 0);
+    for (auto& v : stack) {
+        v = forward(v, to);
+    }
+    env = forward(env, to);
+    for (auto& d : dump) {
+        d.env = forward(d.env, to);
+    }
+    resident = forward(resident, to);
+    for (size_t scan = 0; scan < to.cells.size(); scan++) {
+        Value car = forward(to.cells[scan].car, to);
+        Value cdr = forward(to.cells[scan].cdr, to);
+        to.cells[scan] = {car, cdr};
+    }
+    heap.swap(to.cells);
+    heap_limit = std::max(MIN_HEAP, 2 * heap.size());
+    heap.reserve(heap_limit);
+    bignums.swap(to.bignums);
+    bignum_limit = std::max(MIN_BIGNUMS, 2 * bignums.size());
+}
+
+SecdVM::Value SecdVM::forward(Value v, ToSpace& to) {
+    if (isBig(v)) {
+        size_t big = (v >> 3) - FIRST_BIG;
+        if (big < pinned_bignums) {
+            return v;
+        }
+        uint32_t& moved = to.moved[big - pinned_bignums];
+        if (moved == 0) {
+            to.bignums.push_back(std::move(bignums[big]));
+            moved = to.bignums.size();
+        }
+        return static_cast<Value>(moved - 1 + FIRST_BIG) << 3 | 4;
+    }
+    if (!isCons(v) && !isClosure(v)) {
+        return v;
+    }
+    size_t index = v >> 3;
+    if (index < pinned) {
+        return v;
+    }
+    Cell& from = heap[index];
+    if (from.car != FORWARDED) {
+        to.cells.push_back(from);
+        from = {FORWARDED, static_cast<Value>(to.cells.size() - 1) << 3};
+    }
+    return from.cdr | (v & 7);
+}
+
+SecdVM::Value SecdVM::arithmetic(Op op, Value left, Value right) {
+    static const char* errors[] = {
+        "Add operation requires integer operands", "Sub operation requires integer operands",
+        "Mul operation requires integer operands", "Dive operation requires integer operands",
+        "Rem operation requires integer operands"
+    };
+    if (!isInt(left) || !isInt(right)) {
+        throw std::runtime_error(errors[static_cast<int>(op) - static_cast<int>(Op::ADD)]);
+    }
+
+    if (isFixnum(left) && isFixnum(right)) {
+        int64_t a = fixnumValue(left), b = fixnumValue(right), r = 0;
+        bool overflow = false;
+        switch (op) {
+            case Op::ADD: r = a + b; break;
+            case Op::SUB: r = a - b; break;
+            case Op::MUL: overflow = __builtin_mul_overflow(a, b, &r); break;
+            case Op::DIVE:
+            case Op::REM:
+                if (b == 0) {
+                    throw std::runtime_error("Division by zero");
+                }
+                r = (op == Op::DIVE) ? a / b : a % b;
+                break;
+            default: break;
+        }
+        // сумма и разность 62-битных чисел не переполняют int64, проверяется только диапазон fixnum
+        if (!overflow && r >= FIXNUM_MIN && r <= FIXNUM_MAX) {
+            return fixnum(r);
+        }
+    }
+
+    cBigNumber a = bigValue(left), b = bigValue(right);
+    switch (op) {
+        case Op::ADD: return integer(a + b);
+        case Op::SUB: return integer(a - b);
+        case Op::MUL: return integer(a * b);
+        case Op::DIVE:
+        case Op::REM:
+            if (b == 0) {
+                throw std::runtime_error("Division by zero");
+            }
+            // как в Emulator: x / -1 = 0 - x, иначе 2^63 уходит в деление cBigNumber на -1
+            if (b == -1) {
+                return op == Op::DIVE ? integer(0 - a) : fixnum(0);
+            }
+            if (op == Op::DIVE) {
+                return integer(a / b);
+            }
+            return integer(a % b);
+        default: break;
+    }
+    throw std::runtime_error("Secd: unknown arithmetic operation");
+}
+
+bool SecdVM::equal(Value left, Value right) {
+    if (isCons(left) && isCons(right)) {
+        throw std::runtime_error("Equal operation requires 1 or 2 atom operands");
+    }
+    if (left == right) {
+        return true;
+    }
+    if (isBig(left) && isBig(right)) {
+        return bigValue(left) == bigValue(right);
+    }
+    // как в Emulator: замыкания сравниваются по типу узла, то есть всегда равны
+    return isClosure(left) && isClosure(right);
+}
+
+SecdVM::Value SecdVM::applyUnary(Op op, Value v) {
+    switch (op) {
+        case Op::CAR:
+        case Op::CDR:
+            if (v == NIL) {
+                return NIL;
+            }
+            if (isCons(v)) {
+                return op == Op::CAR ? cell(v).car : cell(v).cdr;
+            }
+            throw std::runtime_error(op == Op::CAR ? "Car error: arg must be Nil or List" : "Cdr error: arg must be Nil or List");
+        case Op::ATOM:
+            return boolean(!isCons(v));
+        case Op::LITERAL:
+            return boolean(isInt(v) || v == NIL || v == TRUE || v == FALSE);
+        default:
+            break;
+    }
+    throw std::runtime_error("Secd: unknown unary operation");
+}
+
+SecdVM::Value SecdVM::applyBinary(Op op, Value left, Value right) {
+    switch (op) {
+        case Op::CONS:
+            // left - хвост (лежит глубже), right - голова (вершина стека)
+            if (!isCons(left) && left != NIL) {
+                throw std::runtime_error("Cons error: second param must be List or Nil");
+            }
+            return cons(right, left);
+        case Op::LE:
+            if (!isInt(left) || !isInt(right)) {
+                throw std::runtime_error("Le operation requires integer operands");
+            }
+            if (isFixnum(left) && isFixnum(right)) {
+                return boolean(fixnumValue(left) <= fixnumValue(right));
+            }
+            return boolean(bigValue(left) <= bigValue(right));
+        case Op::EQUAL:
+            return boolean(equal(left, right));
+        default:
+            return arithmetic(op, left, right);
+    }
+}
+
+// Прямой шитый код: при загрузке каждой инструкции сопоставляется адрес её обработчика
+// (computed goto GCC/Clang), и обработчик сам переходит к следующему, без общего switch.
+// На других компиляторах (или с -DSECD_NO_THREADED) используется обычный switch.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(SECD_NO_THREADED)
+#define SECD_THREADED 1
+#endif
+
+#ifdef SECD_THREADED
+#define SECD_CASE(name) L_##name:
+#define SECD_NEXT() do { instr = &code[pc]; goto *threaded[pc++]; } while (0)
+#else
+#define SECD_CASE(name) case Op::name:
+#define SECD_NEXT() continue
+#endif
+
+// JIT подменяет обработчик первой инструкции участка, поэтому нужен шитый код
+#if defined(SECD_JIT) && defined(SECD_THREADED)
+#define SECD_ENTER() do { \
+        if (jit && jit->hot(pc)) { \
+            for (uint32_t p : jit->compile(pc)) threaded[p] = &&L_NATIVE; \
+        } \
+    } while (0)
+#else
+#undef SECD_JIT
+#define SECD_ENTER() do {} while (0)
+#endif
+
+void SecdVM::predecode() {
+    execute(PREDECODE);
+    jit.reset();
+#ifdef SECD_JIT
+    if (use_jit) {
+        jit = std::make_unique<SecdJit>(*this);
+    }
+#endif
+}
+
+SecdVM::Value SecdVM::execute(uint32_t pc) {
+#ifdef SECD_THREADED
+    // порядок совпадает с enum class Op
+    static const void* const labels[] = {
+        &&L_LD, &&L_LDC, &&L_LDF, &&L_AP, &&L_RTN, &&L_SEL, &&L_JOIN, &&L_DUM, &&L_RAP, &&L_STOP,
+        &&L_CAR, &&L_CDR, &&L_ATOM, &&L_LITERAL, &&L_CONS, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIVE,
+        &&L_REM, &&L_LE, &&L_EQUAL, &&L_TAP, &&L_TRAP, &&L_TSEL, &&L_LDAP, &&L_LDTAP, &&L_FRAME
+    };
+    if (pc == PREDECODE) {
+        threaded.resize(code_count);
+        for (uint32_t i = 0; i < code_count; i++) {
+            threaded[i] = labels[static_cast<int>(code[i].op)];
+        }
+        return NIL;
+    }
+    const Instr* instr;
+    SECD_NEXT();
+#else
+    if (pc == PREDECODE) {
+        return NIL;
+    }
+    for (;;) {
+    const Instr* instr = &code[pc++];
+    switch (instr->op) {
+#endif
+
+    SECD_CASE(LD) {
+        Value e = env;
+        for (uint32_t i = 0; i < instr->a; i++) {
+            e = cell(e).cdr;
+        }
+        Value frame = cell(e).car;
+        for (uint32_t j = 0; j < instr->b; j++) {
+            frame = cell(frame).cdr;
+        }
+        stack.push_back(cell(frame).car);
+        SECD_NEXT();
+    }
+    SECD_CASE(LDC) {
+        stack.push_back(constants[instr->a]);
+        SECD_NEXT();
+    }
+    SECD_CASE(LDF) {
+        stack.push_back(closure(instr->a, env));
+        SECD_NEXT();
+    }
+    SECD_CASE(AP) {
+        Value f = pop();
+        Value args = pop();
+        if (!isClosure(f)) {
+            throw std::runtime_error("Function call: first element must be a closure");
+        }
+        dump.push_back({stack.size(), env, pc});
+        env = cons(args, cell(f).cdr);
+        pc = fixnumValue(cell(f).car);
+        safepoint();
+        SECD_ENTER();
+        SECD_NEXT();
+    }
+    SECD_CASE(RTN) {
+        Value result = pop();
+        if (dump.empty()) {
+            throw std::runtime_error("Secd: RTN with empty dump");
+        }
+        DumpEntry d = dump.back();
+        dump.pop_back();
+        stack.resize(d.sp);
+        stack.push_back(result);
+        env = d.env;
+        pc = d.pc;
+        SECD_NEXT();
+    }
+    SECD_CASE(SEL) {
+        Value test = pop();
+        if (test != TRUE && test != FALSE) {
+            throw std::runtime_error("Cond error!");
+        }
+        dump.push_back({stack.size(), env, pc});
+        pc = (test == TRUE) ? instr->a : instr->b;
+        SECD_NEXT();
+    }
+    SECD_CASE(JOIN) {
+        if (dump.empty()) {
+            throw std::runtime_error("Secd: JOIN with empty dump");
+        }
+        pc = dump.back().pc;
+        dump.pop_back();
+        SECD_NEXT();
+    }
+    SECD_CASE(DUM) {
+        env = cons(OMEGA, env);
+        SECD_NEXT();
+    }
+    SECD_CASE(RAP) {
+        Value f = pop();
+        Value args = pop();
+        if (!isClosure(f) || !isCons(cell(f).cdr) || cell(cell(f).cdr).car != OMEGA) {
+            throw std::runtime_error("Secd: RAP expects a closure over a DUM frame");
+        }
+        Value frame = cell(f).cdr;
+        dump.push_back({stack.size(), cell(env).cdr, pc});
+        // rplaca: кадр OMEGA заменяется значениями, замыкания видят его через общее окружение
+        cell(frame).car = args;
+        env = frame;
+        pc = fixnumValue(cell(f).car);
+        safepoint();
+        SECD_ENTER();
+        SECD_NEXT();
+    }
+    SECD_CASE(STOP) {
+        return stack.empty() ? NIL : stack.back();
+    }
+    SECD_CASE(CAR)
+    SECD_CASE(CDR)
+    SECD_CASE(ATOM)
+    SECD_CASE(LITERAL) {
+        stack.push_back(applyUnary(instr->op, pop()));
+        SECD_NEXT();
+    }
+    SECD_CASE(CONS)
+    SECD_CASE(ADD)
+    SECD_CASE(SUB)
+    SECD_CASE(MUL)
+    SECD_CASE(DIVE)
+    SECD_CASE(REM)
+    SECD_CASE(LE)
+    SECD_CASE(EQUAL) {
+        Value right = pop();
+        Value left = pop();
+        stack.push_back(applyBinary(instr->op, left, right));
+        SECD_NEXT();
+    }
+    SECD_CASE(TAP) {
+        // AP перед RTN: вызываемая функция вернёт результат прямо в дамп вызывающей
+        Value f = pop();
+        Value args = pop();
+        if (!isClosure(f)) {
+            throw std::runtime_error("Function call: first element must be a closure");
+        }
+        env = cons(args, cell(f).cdr);
+        pc = fixnumValue(cell(f).car);
+        safepoint();
+        SECD_ENTER();
+        SECD_NEXT();
+    }
+    SECD_CASE(TRAP) {
+        Value f = pop();
+        Value args = pop();
+        if (!isClosure(f) || !isCons(cell(f).cdr) || cell(cell(f).cdr).car != OMEGA) {
+            throw std::runtime_error("Secd: RAP expects a closure over a DUM frame");
+        }
+        Value frame = cell(f).cdr;
+        cell(frame).car = args;
+        env = frame;
+        pc = fixnumValue(cell(f).car);
+        safepoint();
+        SECD_ENTER();
+        SECD_NEXT();
+    }
+    SECD_CASE(TSEL) {
+        // SEL перед RTN: ветви заканчиваются RTN, продолжение в дамп не кладётся
+        Value test = pop();
+        if (test != TRUE && test != FALSE) {
+            throw std::runtime_error("Cond error!");
+        }
+        pc = (test == TRUE) ? instr->a : instr->b;
+        SECD_NEXT();
+    }
+    SECD_CASE(LDAP)
+    SECD_CASE(LDTAP) {
+        Value e = env;
+        for (uint32_t i = 0; i < instr->a; i++) {
+            e = cell(e).cdr;
+        }
+        Value f = cell(e).car;
+        for (uint32_t j = 0; j < instr->b; j++) {
+            f = cell(f).cdr;
+        }
+        f = cell(f).car;
+        Value args = pop();
+        if (!isClosure(f)) {
+            throw std::runtime_error("Function call: first element must be a closure");
+        }
+        if (instr->op == Op::LDAP) {
+            dump.push_back({stack.size(), env, pc});
+        }
+        env = cons(args, cell(f).cdr);
+        pc = fixnumValue(cell(f).car);
+        safepoint();
+        SECD_ENTER();
+        SECD_NEXT();
+    }
+    SECD_CASE(FRAME) {
+        // k значений на вершине стека; верхнее становится головой списка
+        if (instr->a > stack.size()) {
+            throw std::runtime_error("Secd: stack underflow");
+        }
+        size_t base = stack.size() - instr->a;
+        Value list = NIL;
+        for (size_t i = base; i < stack.size(); i++) {
+            list = cons(stack[i], list);
+        }
+        stack.resize(base);
+        stack.push_back(list);
+        SECD_NEXT();
+    }
+
+#ifdef SECD_JIT
+    L_NATIVE: {
+        // вход в скомпилированный участок; он возвращает инструкцию, с которой продолжит
+        // интерпретатор, а её обработчик берётся из labels, а не из подменённого threaded
+        const SecdJit::Entry& native = jit->entry(pc - 1);
+        if (stack.size() >= static_cast<size_t>(-native.min_depth)) {
+            size_t base = stack.size();
+            stack.resize(base + native.max_depth);
+            SecdJit::Context ctx = {stack.data() + base, heap.data(), env, this, 0};
+            pc = native.code(&ctx);
+            stack.resize(base + ctx.depth);
+        }
+        else {
+            pc--;
+        }
+        instr = &code[pc];
+        goto *labels[static_cast<int>(code[pc++].op)];
+    }
+#endif
+
+#ifndef SECD_THREADED
+    }
+    }
+#endif
+}
+
+#undef SECD_CASE
+#undef SECD_NEXT
+#undef SECD_ENTER
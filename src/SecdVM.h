@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AST.h"
+#include "MappedFile.h"
+
+class SecdJit;
+class SecdAot;
+struct SecdNative;
+
+// Машина SECD для кода, который порождает compiler.lisp (файлы .secd).
+// Код при загрузке декодируется в плоский массив инструкций: вложенные блоки LDF и SEL
+// дописываются в конец массива, а инструкция хранит индекс их начала.
+// Регистры: S - стек значений, E - окружение (список кадров-списков),
+// C - индекс текущей инструкции, D - дамп сохранённых (S, E, C).
+class SecdVM {
+public:
+    // Значение машины - 64-битное слово с тегом в младших битах:
+    //   ...1   целое (fixnum) со сдвигом на 1
+    //   .000   индекс cons-ячейки
+    //   .010   номер символа
+    //   .100   константа (NIL, TRUE, FALSE, OMEGA) или номер длинного целого
+    //   .110   индекс замыкания
+    typedef uint64_t Value;
+
+    // после EQUAL - инструкции оптимизатора, в тексте SECD их нет:
+    //   TAP, TRAP   - AP и RAP перед RTN, без записи в дамп
+    //   TSEL        - SEL перед RTN, ветви заканчиваются RTN вместо JOIN
+    //   LDAP, LDTAP - LD (i j) с последующим AP / TAP
+    //   FRAME k     - список из k значений с вершины стека (вместо LDC NIL и k CONS)
+    enum class Op : unsigned char {
+        LD, LDC, LDF, AP, RTN, SEL, JOIN, DUM, RAP, STOP,
+        CAR, CDR, ATOM, LITERAL, CONS, ADD, SUB, MUL, DIVE, REM, LE, EQUAL,
+        TAP, TRAP, TSEL, LDAP, LDTAP, FRAME
+    };
+
+    struct Instr {
+        Op op;
+        unsigned char reserved[3] = {};
+        uint32_t a = 0; // LD/LDAP: номер кадра, LDC: номер константы, LDF/SEL: начало блока, FRAME: k
+        uint32_t b = 0; // LD/LDAP: номер ячейки, SEL: начало блока else
+    };
+    static_assert(sizeof(Instr) == 12, "Instr is stored in bytecode files as is");
+
+    // Двоичный образ (.secdb): заголовок, затем секции, выровненные на 8 байт:
+    //   code      - массив Instr, исполняется прямо из отображённого файла
+    //   constants - значения для LDC
+    //   cells     - cons-ячейки, на которые ссылаются константы (начало кучи)
+    //   symbols   - имена символов по номерам: uint32 длина + байты
+    //   bignums   - длинные целые по номерам: uint32 длина + десятичная запись
+    // В образе с вычисленной программой (evaluate) cells содержат и построенное ею
+    // окружение, а result - её значение; run тогда не выполняет программу заново.
+    static constexpr char BYTECODE_MAGIC[8] = {'L', 'F', 'K', 'S', 'E', 'C', 'D', 0};
+    static constexpr uint32_t BYTECODE_VERSION = 3;
+
+    struct BytecodeHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t entry;          // начало программы
+        uint32_t apply;          // блок (AP STOP) для применения к входу
+        uint32_t code_count;
+        uint32_t constant_count;
+        uint32_t cell_count;
+        uint32_t symbol_count;
+        uint32_t bignum_count;
+        uint64_t code_offset;
+        uint64_t constant_offset;
+        uint64_t cell_offset;
+        uint64_t symbol_offset;
+        uint64_t bignum_offset;
+        uint64_t result;         // значение программы или OMEGA, если она не вычислена
+    };
+
+private:
+    friend class SecdJit;
+    friend class SecdAot;
+    friend struct SecdNative;
+
+    static constexpr Value NIL = 0 << 3 | 4;
+    static constexpr Value TRUE = 1 << 3 | 4;
+    static constexpr Value FALSE = 2 << 3 | 4;
+    static constexpr Value OMEGA = 3 << 3 | 4;
+    static constexpr Value FIRST_BIG = 4;
+
+    // помечает скопированную ячейку, cdr тогда - её новый индекс; номер длинного числа
+    // в такой константе недостижим
+    static constexpr Value FORWARDED = ~Value(0) << 3 | 4;
+    static constexpr size_t MIN_HEAP = size_t(1) << 20;
+    static constexpr size_t MIN_BIGNUMS = size_t(1) << 16;
+
+    static constexpr int64_t FIXNUM_MIN = -(int64_t(1) << 62);
+    static constexpr int64_t FIXNUM_MAX = (int64_t(1) << 62) - 1;
+
+    // cons-ячейка; у замыкания car - начало кода (fixnum), cdr - окружение
+    struct Cell {
+        Value car;
+        Value cdr;
+    };
+
+    // вложенный блок кода до размещения; tail - ветвь SEL в хвостовой позиции
+    struct SubBlock {
+        Ref<syntax_tree::ASTNode> code;
+        bool tail;
+    };
+
+    struct DumpEntry {
+        size_t sp;
+        Value env;
+        uint32_t pc;
+    };
+
+    // код и константы либо декодированы из текста в *_storage, либо лежат в image
+    bool optimize;
+    bool use_jit;
+    std::vector<Instr> code_storage;
+    std::vector<Value> constant_storage;
+    std::unique_ptr<MappedFile> image;
+    const Instr* code = nullptr;
+    const Value* constants = nullptr;
+    uint32_t code_count = 0;
+    uint32_t constant_count = 0;
+    uint32_t entry = 0;
+    uint32_t apply = 0;
+    // значение программы, сохранённое evaluate; OMEGA - программа ещё не выполнялась
+    Value resident = OMEGA;
+    // адреса обработчиков инструкций для шитого кода, заполняются при загрузке
+    std::vector<const void*> threaded;
+    // JIT горячих тел LDF; создаётся заново при каждой загрузке
+    std::unique_ptr<SecdJit> jit;
+    // Куча с копирующей сборкой мусора (Чейни). Ячейки [0, pinned) - константы кода и
+    // ячейки образа: на них ссылаются constants (возможно, из отображённого файла), поэтому
+    // они не перемещаются. Остальные ячейки, достижимые из S, E, D и resident, копируются
+    // в новую кучу; выделение - push_back в заранее зарезервированную память.
+    // Длинные числа [0, pinned_bignums) загружены с кодом и тоже не перемещаются,
+    // живые из остальных переписываются в новую таблицу под новыми номерами.
+    std::vector<Cell> heap;
+    size_t pinned = 0;
+    size_t heap_limit = MIN_HEAP;
+    std::vector<cBigNumber> bignums;
+    size_t pinned_bignums = 0;
+    size_t bignum_limit = MIN_BIGNUMS;
+    std::vector<syntax_tree::Symbol> symbols;
+    std::unordered_map<syntax_tree::Symbol, uint32_t> symbol_ids;
+
+    std::vector<Value> stack;
+    Value env = NIL;
+    std::vector<DumpEntry> dump;
+
+    static bool isFixnum(Value v) { return v & 1; }
+    static bool isCons(Value v) { return (v & 7) == 0; }
+    static bool isSymbol(Value v) { return (v & 7) == 2; }
+    static bool isClosure(Value v) { return (v & 7) == 6; }
+    static bool isBig(Value v) { return (v & 7) == 4 && (v >> 3) >= FIRST_BIG; }
+    static bool isInt(Value v) { return isFixnum(v) || isBig(v); }
+    static int64_t fixnumValue(Value v) { return static_cast<int64_t>(v) >> 1; }
+    static Value fixnum(int64_t n) { return (static_cast<Value>(n) << 1) | 1; }
+    static Value boolean(bool b) { return b ? TRUE : FALSE; }
+
+    // ячейка пары или замыкания; испорченный код (LD за пределы окружения, чужой тег)
+    // получает ошибку вместо чтения мимо кучи
+    Cell& cell(Value v) {
+        if ((!isCons(v) && !isClosure(v)) || (v >> 3) >= heap.size()) {
+            throw std::runtime_error("Secd: bad heap reference");
+        }
+        return heap[v >> 3];
+    }
+    // закрепляет ячейки, загруженные вместе с кодом
+    void pin();
+    Value cons(Value car, Value cdr);
+    Value closure(uint32_t pc, Value env);
+    Value symbol(syntax_tree::Symbol name);
+    Value integer(const cBigNumber& n);
+    cBigNumber bigValue(Value v);
+
+    // загрузка
+    uint32_t loadBlock(const Ref<syntax_tree::ASTNode>& block, bool tail);
+    void peephole(std::vector<Instr>& instrs, std::vector<SubBlock>& blocks);
+    void foldConstants(std::vector<Instr>& instrs);
+    void buildFrames(std::vector<Instr>& instrs);
+    Value toValue(const Ref<syntax_tree::ASTNode>& node);
+    Ref<syntax_tree::ASTNode> fromValue(Value v);
+
+    // выполнение
+    static constexpr uint32_t PREDECODE = UINT32_MAX;
+    void predecode();
+    Value execute(uint32_t pc);
+    Value pop();
+    // куда collect переносит живое; moved[i] - новый номер подвижного длинного числа i
+    // плюс один (0 - ещё не перенесено)
+    struct ToSpace {
+        std::vector<Cell> cells;
+        std::vector<cBigNumber> bignums;
+        std::vector<uint32_t> moved;
+    };
+    // Сборка запускается только в точках вызова (AP, RAP и их хвостовые формы), когда
+    // все живые значения лежат в регистрах машины, а не в локальных переменных C++
+    // или в коде JIT: участки JIT не содержат вызовов.
+    void safepoint() { if (heap.size() >= heap_limit || bignums.size() >= bignum_limit) collect(); }
+    void collect();
+    Value forward(Value v, ToSpace& to);
+    Value arithmetic(Op op, Value left, Value right);
+    bool equal(Value left, Value right);
+    Value applyUnary(Op op, Value v);
+    Value applyBinary(Op op, Value left, Value right);
+
+public:
+    // optimize включает оптимизатор (свёртка констант, хвостовые вызовы, суперинструкции),
+    // jit - компиляцию горячих тел в машинный код (где она доступна)
+    explicit SecdVM(bool optimize = true, bool jit = true);
+    ~SecdVM();
+
+    // загрузка программы из текста SECD или из двоичного образа
+    void load(syntax_tree::AST program);
+    void loadBytecode(const std::string& filename);
+    void saveBytecode(const std::string& filename);
+    static bool isBytecode(const std::string& filename);
+
+    // Выполняет программу один раз и запоминает её значение вместе с кучей: образ,
+    // сохранённый после этого, сразу применяет готовое замыкание (например, COMPILE
+    // с окружением LETREC компилятора) к входу, не строя окружение заново.
+    void evaluate();
+
+    // Выполняет загруженную программу. Если задан input, а результат программы -
+    // замыкание, оно применяется к списку (input), как программа LispKit к своему входу.
+    syntax_tree::AST run(syntax_tree::AST input = syntax_tree::AST());
+};
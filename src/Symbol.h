@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+
+namespace syntax_tree {
+
+// Интернированное имя. Каждое имя хранится в таблице один раз, поэтому одинаковые
+// идентификаторы получают один и тот же указатель и сравниваются за O(1).
+typedef const std::string* Symbol;
+
+inline Symbol intern(const std::string& name) {
+    // адреса элементов unordered_set не меняются при перехешировании
+    static std::unordered_set<std::string> table;
+    return &*table.insert(name).first;
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "cBigNumber/Cbignum.h"
+#include "Ref.h"
+#include "Symbol.h"
+
+namespace syntax_tree {
+
+class ASTNode;
+enum class NodeKind : unsigned char;
+// счёт ссылок на узлы определён в AST.h
+void refRetain(ASTNode* node);
+void refRelease(ASTNode* node);
+
+// Значение вычислителей над AST (Emulator, CekEmulator, ClosureEmulator) - одно слово
+// с тегом в младших битах, как SecdVM::Value:
+//   ...1   целое из 63 бит
+//   ..000  узел в куче со счётчиком ссылок: пара, замыкание, длинное целое,
+//          ключевое слово из quote; 0 - отсутствие значения
+//   ..010  интернированный символ
+//   ..100  NIL, TRUE, FALSE
+// Числа, логические значения, NIL и символы не выделяют память и не трогают счётчики.
+// Целое всегда в самом коротком виде: узел LiteralInt заводится только для чисел вне
+// диапазона fixnum, поэтому одинаковые числа всегда имеют одинаковое представление.
+class Value {
+private:
+    uint64_t bits = 0;
+
+    explicit Value(uint64_t bits) : bits(bits) {}
+
+    static constexpr uint64_t NIL_BITS = 4;
+    static constexpr uint64_t TRUE_BITS = 12;
+    static constexpr uint64_t FALSE_BITS = 20;
+
+    ASTNode* pointer() const { return reinterpret_cast<ASTNode*>(bits); }
+
+public:
+    static constexpr int64_t FIXNUM_MIN = -(int64_t(1) << 62);
+    static constexpr int64_t FIXNUM_MAX = (int64_t(1) << 62) - 1;
+
+    Value() {}
+    Value(std::nullptr_t) {}
+    Value(const Value& other) : bits(other.bits) {
+        if (isNode()) refRetain(pointer());
+    }
+    Value(Value&& other) noexcept : bits(other.bits) { other.bits = 0; }
+    ~Value() {
+        if (isNode()) refRelease(pointer());
+    }
+    Value& operator=(Value other) noexcept {
+        std::swap(bits, other.bits);
+        return *this;
+    }
+
+    static Value fixnum(int64_t v) { return Value((static_cast<uint64_t>(v) << 1) | 1); }
+    static Value boolean(bool v) { return Value(v ? TRUE_BITS : FALSE_BITS); }
+    static Value nil() { return Value(NIL_BITS); }
+    static Value symbol(Symbol s) { return Value(reinterpret_cast<uint64_t>(s) | 2); }
+    // узел как есть; числа, логические значения, NIL и идентификаторы - через fromNode
+    static Value box(const Ref<ASTNode>& node) {
+        Value v(reinterpret_cast<uint64_t>(node.get()));
+        if (v.isNode()) refRetain(v.pointer());
+        return v;
+    }
+    static bool fitsFixnum(long long v) { return v >= FIXNUM_MIN && v <= FIXNUM_MAX; }
+
+    // определены в AST.h
+    static Value integer(long long v);
+    static Value integer(const cBigNumber& v);
+    static Value fromNode(const Ref<ASTNode>& node);
+    Ref<ASTNode> toNode() const;
+    NodeKind getKind() const;
+    bool isList() const;
+    void print(int indent = 0, std::ostream& os = std::cout) const;
+    void printFlat(int depth = 0, std::ostream& os = std::cout) const;
+
+    explicit operator bool() const { return bits != 0; }
+    bool isFixnum() const { return bits & 1; }
+    bool isNode() const { return bits != 0 && (bits & 7) == 0; }
+    bool isSymbol() const { return (bits & 7) == 2; }
+    bool isNil() const { return bits == NIL_BITS; }
+    bool isTrue() const { return bits == TRUE_BITS; }
+    bool isFalse() const { return bits == FALSE_BITS; }
+
+    int64_t fixnumValue() const { return static_cast<int64_t>(bits) >> 1; }
+    Symbol getSymbol() const { return reinterpret_cast<Symbol>(bits & ~uint64_t(7)); }
+    // узел без захвата ссылки; живёт, пока живо значение
+    ASTNode* node() const { return pointer(); }
+
+    // одинаковое слово: для непосредственных значений это равенство значений
+    bool same(const Value& other) const { return bits == other.bits; }
+};
+
+}
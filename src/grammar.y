@@ -28,7 +28,7 @@
     YY_DECL;
 }
 
-%nonassoc <std::string> T_IDENTIFIER
+%nonassoc <syntax_tree::Symbol> T_IDENTIFIER
 %nonassoc <std::string> T_LITERAL_INT
 %nonassoc T_LITERAL_NIL T_LITERAL_TRUE T_LITERAL_FALSE
 %nonassoc T_PARENTHESIS_OPEN T_PARENTHESIS_CLOSE
@@ -43,13 +43,13 @@
 // Специальные формы
 %nonassoc <std::string> T_LAMBDA T_LET T_LETREC 
 
-%type <std::shared_ptr<syntax_tree::ASTNode>> s expr atom list application const consts keyword unaryop binaryop ternaryop bind num id
-%type <std::vector<std::shared_ptr<syntax_tree::ASTNode>>> params bindings bindingsTail
+%type <Ref<syntax_tree::ASTNode>> s expr atom list application const consts keyword unaryop binaryop ternaryop bind num id
+%type <std::vector<Ref<syntax_tree::ASTNode>>> items constItems params bindings
 
 %%
 
 s: expr T_END_OF_FILE {
-    result = syntax_tree::AST($1);
+    result.setRoot($1);
     YYACCEPT;
 };
 
@@ -61,37 +61,45 @@ expr: atom { $$ = $1; }
 
 atom: id { $$ = $1; }
     | num { $$ = $1; }
-    | T_LITERAL_NIL { $$ = std::make_shared<syntax_tree::LiteralNil>("NIL"); }
-    | T_LITERAL_TRUE { $$ = std::make_shared<syntax_tree::LiteralBool>("LiteralBool", true); }
-    | T_LITERAL_FALSE { $$ = std::make_shared<syntax_tree::LiteralBool>("LiteralBool", false); };
-
-list: expr list {
-        auto l = std::make_shared<syntax_tree::ListNode>("LIST");
-        l->addStatement($1);
-        l->addStatements($2->getStatements());
-        $$ = l;
-    }
-    | %empty { $$ = std::make_shared<syntax_tree::LiteralNil>("NIL"); };
-    
+    | T_LITERAL_NIL { $$ = syntax_tree::makeNil(); }
+    | T_LITERAL_TRUE { $$ = syntax_tree::makeBool(true); }
+    | T_LITERAL_FALSE { $$ = syntax_tree::makeBool(false); };
+
+// Узлы создаются в арене дерева result. Списки собираются левой рекурсией в вектор,
+// который переходит в ListNode целиком, без промежуточного узла на каждый хвост.
+list: items {
+        if ($1.empty()) {
+            $$ = syntax_tree::makeNil();
+        }
+        else {
+            auto l = result.make<syntax_tree::ListNode>();
+            l->setStatements(std::move($1));
+            $$ = l;
+        }
+    };
+
+items: items expr { $1.push_back($2); $$ = std::move($1); }
+    | %empty { $$ = std::vector<Ref<syntax_tree::ASTNode>>(); };
+
 
 application: const { $$ = $1; } 
     | unaryop expr { $1->addStatement($2); $$ = $1; }
     | binaryop expr expr { $1->addStatement($2); $1->addStatement($3); $$ = $1; }
     | ternaryop expr expr expr { $1->addStatement($2); $1->addStatement($3); $1->addStatement($4); $$ = $1; }
     | T_LAMBDA T_PARENTHESIS_OPEN params T_PARENTHESIS_CLOSE expr {
-        auto l = std::make_shared<syntax_tree::LambdaNode>("LAMBDA");
-        l->setStatements($3); 
+        auto l = result.make<syntax_tree::LambdaNode>();
+        l->setStatements(std::move($3));
         l->addStatement($5);
         $$ = l;
     }
     | T_LET expr bindings {
-        auto l = std::make_shared<syntax_tree::LetNode>("LET");
+        auto l = result.make<syntax_tree::LetNode>();
         l->addStatement($2);
         l->addStatements($3); 
         $$ = l;
     }
     | T_LETREC expr bindings {
-        auto l = std::make_shared<syntax_tree::LetrecNode>("LETREC");
+        auto l = result.make<syntax_tree::LetrecNode>();
         l->addStatement($2);
         l->addStatements($3); 
         $$ = l;
@@ -99,93 +107,79 @@ application: const { $$ = $1; }
 
 
 const: T_QUOTE keyword {
-        auto l = std::make_shared<syntax_tree::QuoteNode>("QUOTE");
+        auto l = result.make<syntax_tree::QuoteNode>();
         l->addStatement($2);
         $$ = l;
     }
     | T_QUOTE atom {
-        auto l = std::make_shared<syntax_tree::QuoteNode>("QUOTE");
+        auto l = result.make<syntax_tree::QuoteNode>();
         l->addStatement($2);
         $$ = l;
     }
     | T_QUOTE T_PARENTHESIS_OPEN consts T_PARENTHESIS_CLOSE {
-        auto l = std::make_shared<syntax_tree::QuoteNode>("QUOTE");
+        auto l = result.make<syntax_tree::QuoteNode>();
         l->addStatement($3);
         $$ = l;
     };
 
-consts: keyword consts {
-        auto l = std::make_shared<syntax_tree::ListNode>("LIST");
-        l->addStatement($1);
-        l->addStatements($2->getStatements());
-        $$ = l;
-    }
-    | atom consts {
-        auto l = std::make_shared<syntax_tree::ListNode>("LIST");
-        l->addStatement($1);
-        l->addStatements($2->getStatements());
-        $$ = l;
-    }
-    | T_PARENTHESIS_OPEN consts T_PARENTHESIS_CLOSE consts {
-        auto l = std::make_shared<syntax_tree::ListNode>("LIST");
-        l->addStatement($2);
-        l->addStatements($4->getStatements());
-        $$ = l;
-    }
-    | %empty { $$ = std::make_shared<syntax_tree::LiteralNil>("NIL"); };
+consts: constItems {
+        if ($1.empty()) {
+            $$ = syntax_tree::makeNil();
+        }
+        else {
+            auto l = result.make<syntax_tree::ListNode>();
+            l->setStatements(std::move($1));
+            $$ = l;
+        }
+    };
+
+constItems: constItems keyword { $1.push_back($2); $$ = std::move($1); }
+    | constItems atom { $1.push_back($2); $$ = std::move($1); }
+    | constItems T_PARENTHESIS_OPEN consts T_PARENTHESIS_CLOSE { $1.push_back($3); $$ = std::move($1); }
+    | %empty { $$ = std::vector<Ref<syntax_tree::ASTNode>>(); };
 
 keyword: unaryop { $$ = $1; }
     | binaryop { $$ = $1; }
     | ternaryop { $$ = $1; }
-    | T_QUOTE { $$ = std::make_shared<syntax_tree::QuoteNode>("QUOTE"); }
-    | T_LAMBDA { $$ = std::make_shared<syntax_tree::LambdaNode>("LAMBDA"); }
-    | T_LET { $$ = std::make_shared<syntax_tree::LetNode>("LET"); }
-    | T_LETREC { $$ = std::make_shared<syntax_tree::LetrecNode>("LETREC"); };
+    | T_QUOTE { $$ = result.make<syntax_tree::QuoteNode>(); }
+    | T_LAMBDA { $$ = result.make<syntax_tree::LambdaNode>(); }
+    | T_LET { $$ = result.make<syntax_tree::LetNode>(); }
+    | T_LETREC { $$ = result.make<syntax_tree::LetrecNode>(); };
 
 
-unaryop: T_CAR { $$ = std::make_shared<syntax_tree::CarNode>("CAR"); }
-    | T_CDR { $$ = std::make_shared<syntax_tree::CdrNode>("CDR"); }
-    | T_ATOM { $$ = std::make_shared<syntax_tree::AtomNode>("ATOM"); }
-    | T_LITERAL { $$ = std::make_shared<syntax_tree::LiteralNode>("LITERAL");};
+unaryop: T_CAR { $$ = result.make<syntax_tree::CarNode>(); }
+    | T_CDR { $$ = result.make<syntax_tree::CdrNode>(); }
+    | T_ATOM { $$ = result.make<syntax_tree::AtomNode>(); }
+    | T_LITERAL { $$ = result.make<syntax_tree::LiteralNode>();};
 
 
-binaryop: T_ADD { $$ = std::make_shared<syntax_tree::AddNode>("ADD"); }
-    | T_SUB { $$ = std::make_shared<syntax_tree::SubNode>("SUB"); }
-    | T_MUL { $$ = std::make_shared<syntax_tree::MulNode>("MUL"); }
-    | T_DIVE { $$ = std::make_shared<syntax_tree::DiveNode>("DIVE"); }
-    | T_REM { $$ = std::make_shared<syntax_tree::RemNode>("REM"); }
-    | T_LE { $$ = std::make_shared<syntax_tree::LeNode>("LE"); }
-    | T_CONS { $$ = std::make_shared<syntax_tree::ConsNode>("CONS"); }
-    | T_EQUAL { $$ = std::make_shared<syntax_tree::EqualNode>("EQUAL"); };
+binaryop: T_ADD { $$ = result.make<syntax_tree::AddNode>(); }
+    | T_SUB { $$ = result.make<syntax_tree::SubNode>(); }
+    | T_MUL { $$ = result.make<syntax_tree::MulNode>(); }
+    | T_DIVE { $$ = result.make<syntax_tree::DiveNode>(); }
+    | T_REM { $$ = result.make<syntax_tree::RemNode>(); }
+    | T_LE { $$ = result.make<syntax_tree::LeNode>(); }
+    | T_CONS { $$ = result.make<syntax_tree::ConsNode>(); }
+    | T_EQUAL { $$ = result.make<syntax_tree::EqualNode>(); };
 
-ternaryop: T_COND { $$ = std::make_shared<syntax_tree::CondNode>("COND"); };
+ternaryop: T_COND { $$ = result.make<syntax_tree::CondNode>(); };
 
-params: id params {
-        $2.insert($2.begin(), $1);
-        $$ = $2;
-    }
-    | %empty { $$ = std::vector<std::shared_ptr<syntax_tree::ASTNode>>(); };
+params: params id { $1.push_back($2); $$ = std::move($1); }
+    | %empty { $$ = std::vector<Ref<syntax_tree::ASTNode>>(); };
 
 
-bindings: bind bindingsTail {
-    $2.insert($2.begin(), $1);
-    $$ = $2;
-};
-bindingsTail: bind bindingsTail {
-        $2.insert($2.begin(), $1);
-        $$ = $2;
-    }
-    | %empty { $$ = std::vector<std::shared_ptr<syntax_tree::ASTNode>>(); };
+bindings: bindings bind { $1.push_back($2); $$ = std::move($1); }
+    | bind { $$ = std::vector<Ref<syntax_tree::ASTNode>>{$1}; };
 
 
 bind: T_PARENTHESIS_OPEN id expr T_PARENTHESIS_CLOSE { 
-    auto b = std::make_shared<syntax_tree::ASTNode>("ASSIGN");
+    auto b = result.make<syntax_tree::ASTNode>(syntax_tree::NodeKind::Assign);
     b->addStatement($2); b->addStatement($3);
     $$ = b;
 };
 
-num: T_LITERAL_INT { $$ = std::make_shared<syntax_tree::LiteralInt>("LiteralInt", cBigNumber($1.c_str(), 10)); };
-id: T_IDENTIFIER { $$ = std::make_shared<syntax_tree::Identifier>("Identifier", $1); };
+num: T_LITERAL_INT { $$ = result.makeInt(cBigNumber($1.c_str(), 10)); };
+id: T_IDENTIFIER { $$ = result.make<syntax_tree::Identifier>($1); };
 
 %%
 
@@ -1,24 +1,160 @@
 #include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "AST.h"
 #include "Emulator.h"
+#include "CekEmulator.h"
+#include "ClosureEmulator.h"
+#include "Resolver.h"
+#include "SecdReader.h"
+#include "SecdVM.h"
+#include "SecdCompiler.h"
+#include "SecdAot.h"
 
 extern syntax_tree::AST analize(int argc, char* argv[]);
 
 int main(int argc, char* argv[])
 {   
-    syntax_tree::AST ast = analize(argc, argv);
+    // ключи: --cek - вычислитель с продолжениями в куче, --max-depth=N - предел их глубины,
+    // --closures - вычислитель, заранее переводящий AST в функции C++,
+    // --secd - выполнить готовый код SECD на SecdVM, --input=<file> - входные данные для него,
+    // --emit-bytecode=<file> - вместо выполнения сохранить код в двоичном образе,
+    // --emit-image=<file> - то же, но после однократного выполнения программы,
+    // --emit-cpp=<file> - вместо выполнения перевести код в исходный текст C++,
+    // --no-optimize - загружать код SECD без оптимизатора, --no-jit - без компиляции в машинный код,
+    // --compile - скомпилировать программу в код SECD (с --secd - сразу выполнить его)
+    bool cek = false;
+    bool closures = false;
+    bool secd = false;
+    bool optimize = true;
+    bool compile = false;
+    bool jit = true;
+    size_t max_depth = 0;
+    std::string input_file;
+    std::string bytecode_file;
+    std::string image_file;
+    std::string cpp_file;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (i > 0 && std::strcmp(argv[i], "--cek") == 0) {
+            cek = true;
+        }
+        else if (i > 0 && std::strcmp(argv[i], "--closures") == 0) {
+            closures = true;
+        }
+        else if (i > 0 && std::strcmp(argv[i], "--secd") == 0) {
+            secd = true;
+        }
+        else if (i > 0 && std::strncmp(argv[i], "--input=", 8) == 0) {
+            input_file = argv[i] + 8;
+        }
+        else if (i > 0 && std::strcmp(argv[i], "--compile") == 0) {
+            compile = true;
+        }
+        else if (i > 0 && std::strcmp(argv[i], "--no-jit") == 0) {
+            jit = false;
+        }
+        else if (i > 0 && std::strcmp(argv[i], "--no-optimize") == 0) {
+            optimize = false;
+        }
+        else if (i > 0 && std::strncmp(argv[i], "--emit-bytecode=", 16) == 0) {
+            bytecode_file = argv[i] + 16;
+        }
+        else if (i > 0 && std::strncmp(argv[i], "--emit-image=", 13) == 0) {
+            image_file = argv[i] + 13;
+        }
+        else if (i > 0 && std::strncmp(argv[i], "--emit-cpp=", 11) == 0) {
+            cpp_file = argv[i] + 11;
+        }
+        else if (i > 0 && std::strncmp(argv[i], "--max-depth=", 12) == 0) {
+            max_depth = std::stoul(argv[i] + 12);
+        }
+        else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
 
-    if (argc < 3) {
+    syntax_tree::AST ast;
+    syntax_tree::AST input;
+    SecdVM vm(optimize, jit);
+    if (secd) {
+        if (argc < 2) {
+            std::cerr << "Usage: " << argv[0] << " --secd <code_file> [<output_file>] [--input=<data_file>] [--emit-bytecode=<file>] [--emit-image=<file>] [--emit-cpp=<file>] [--compile]" << std::endl;
+            return 1;
+        }
+        try {
+            if (compile) {
+                ast = analize(argc, argv);
+                vm.load(SecdCompiler().compile(ast));
+            }
+            // двоичный образ отображается в память без разбора
+            else if (SecdVM::isBytecode(argv[1])) {
+                vm.loadBytecode(argv[1]);
+            }
+            else {
+                ast = SecdReader().read(argv[1]);
+                vm.load(ast);
+            }
+            if (!bytecode_file.empty()) {
+                vm.saveBytecode(bytecode_file);
+                std::cout << "Bytecode written.\n";
+                return 0;
+            }
+            if (!image_file.empty()) {
+                vm.evaluate();
+                vm.saveBytecode(image_file);
+                std::cout << "Image written.\n";
+                return 0;
+            }
+            if (!cpp_file.empty()) {
+                SecdAot().translate(vm, cpp_file);
+                std::cout << "C++ written.\n";
+                return 0;
+            }
+            if (!input_file.empty()) {
+                input = SecdReader().read(input_file);
+            }
+            if (!compile) {
+                std::cout << "Parse success.\n";
+            }
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Parse error: `" << e.what() << "`\n";
+        }
+    }
+    else {
+        ast = analize(argc, argv);
+    }
+
+    if (argc < 3 && !(secd && ast.isEmpty())) {
         std::cout << "-----------------------------\n";
         std::cout << "----Abstract syntax tree:----\n";
         std::cout << "-----------------------------\n";
         ast.print();
     }
 
-    Emulator* e = new Emulator();
+    Resolver resolver;
+    if (!secd && !compile) {
+        resolver.resolve(ast);
+    }
+
+    Emulator* e = cek ? new CekEmulator(max_depth)
+        : closures ? static_cast<Emulator*>(new ClosureEmulator())
+        : new Emulator();
     syntax_tree::AST result;
     try {
-        result = e->eval(ast);
+        if (secd) {
+            result = vm.run(input);
+        }
+        else if (compile) {
+            result = SecdCompiler().compile(ast);
+        }
+        else {
+            result = e->eval(ast);
+        }
         std::cout << "Evaluation success.\n";
     }
     catch(const std::exception& e) {